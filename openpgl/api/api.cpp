@@ -79,18 +79,24 @@ typedef ISurfaceVolumeField IGuidingField;
 #define OPENPGL_FIELD_STRING "OPENPGL_" OPENPGL_VERSION_STRING "_FIELD"
 
 extern "C" OPENPGL_DLLEXPORT PGLDevice pglNewDevice(PGL_DEVICE_TYPE deviceType, size_t numThreads) OPENPGL_CATCH_BEGIN
+{
+    return pglNewDeviceOnNumaNode(deviceType, numThreads, -1);
+}
+OPENPGL_CATCH_END(nullptr)
+
+extern "C" OPENPGL_DLLEXPORT PGLDevice pglNewDeviceOnNumaNode(PGL_DEVICE_TYPE deviceType, size_t numThreads, int numaNode) OPENPGL_CATCH_BEGIN
 {
 #ifdef OPENPGL_DEVICE_TYPE_CPU_4
     if (deviceType == PGL_DEVICE_TYPE_CPU_4)
-        return (PGLDevice)newDeviceCPU4(numThreads);
+        return (PGLDevice)newDeviceCPU4(numThreads, numaNode);
 #endif
 #ifdef OPENPGL_DEVICE_TYPE_CPU_8
     if (deviceType == PGL_DEVICE_TYPE_CPU_8)
-        return (PGLDevice)newDeviceCPU8(numThreads);
+        return (PGLDevice)newDeviceCPU8(numThreads, numaNode);
 #endif
 #ifdef OPENPGL_DEVICE_TYPE_CPU_16
     if (deviceType == PGL_DEVICE_TYPE_CPU_16)
-        return (PGLDevice)newDeviceCPU16(numThreads);
+        return (PGLDevice)newDeviceCPU16(numThreads, numaNode);
 #endif
 
     throw std::runtime_error("invalid vectorSize parameter!");
@@ -111,6 +117,16 @@ extern "C" OPENPGL_DLLEXPORT PGLField pglDeviceNewField(PGLDevice device, PGLFie
 }
 OPENPGL_CATCH_END(nullptr)
 
+extern "C" OPENPGL_DLLEXPORT PGLField pglDeviceNewFieldReplica(PGLDevice device, PGLField field) OPENPGL_CATCH_BEGIN
+{
+    THROW_IF_NULL_OBJECT(device);
+    THROW_IF_NULL_OBJECT(field);
+    auto *gDevice = (IDevice *)device;
+    auto *gField = (IGuidingField *)field;
+    return (PGLField)gDevice->newFieldReplica(gField);
+}
+OPENPGL_CATCH_END(nullptr)
+
 extern "C" OPENPGL_DLLEXPORT PGLField pglDeviceNewFieldFromFile(PGLDevice device, const char *fieldFileName) OPENPGL_CATCH_BEGIN
 {
     THROW_IF_NULL_OBJECT(device);
@@ -192,6 +208,58 @@ extern "C" OPENPGL_DLLEXPORT void pglFieldUpdateVolume(PGLField field, PGLSample
 }
 OPENPGL_CATCH_END_VOID
 
+extern "C" OPENPGL_DLLEXPORT void pglFieldUpdateAsync(PGLField field, PGLSampleStorage sampleStorage) OPENPGL_CATCH_BEGIN
+{
+    auto *gField = (IGuidingField *)field;
+    auto *gSampleStorage = (openpgl::SampleDataStorage *)sampleStorage;
+    gField->updateFieldAsync(gSampleStorage->m_surfaceContainer, gSampleStorage->m_volumeContainer);
+}
+OPENPGL_CATCH_END_VOID
+
+extern "C" OPENPGL_DLLEXPORT bool pglFieldIsUpdateFinished(PGLField field) OPENPGL_CATCH_BEGIN
+{
+    const auto *gField = (const IGuidingField *)field;
+    return gField->isUpdateFinished();
+}
+OPENPGL_CATCH_END(false)
+
+extern "C" OPENPGL_DLLEXPORT void pglFieldWaitForUpdate(PGLField field) OPENPGL_CATCH_BEGIN
+{
+    auto *gField = (IGuidingField *)field;
+    gField->waitForUpdate();
+}
+OPENPGL_CATCH_END_VOID
+
+extern "C" OPENPGL_DLLEXPORT void pglFieldBeginUpdate(PGLField field) OPENPGL_CATCH_BEGIN
+{
+    auto *gField = (IGuidingField *)field;
+    gField->beginUpdate();
+}
+OPENPGL_CATCH_END_VOID
+
+extern "C" OPENPGL_DLLEXPORT void pglFieldAddSampleChunk(PGLField field, PGLSampleStorage sampleStorage) OPENPGL_CATCH_BEGIN
+{
+    auto *gField = (IGuidingField *)field;
+    auto *gSampleStorage = (openpgl::SampleDataStorage *)sampleStorage;
+    gField->addSampleChunk(gSampleStorage->m_surfaceContainer, gSampleStorage->m_volumeContainer);
+}
+OPENPGL_CATCH_END_VOID
+
+extern "C" OPENPGL_DLLEXPORT void pglFieldEndUpdate(PGLField field) OPENPGL_CATCH_BEGIN
+{
+    auto *gField = (IGuidingField *)field;
+    gField->endUpdate();
+}
+OPENPGL_CATCH_END_VOID
+
+extern "C" OPENPGL_DLLEXPORT PGLField pglFieldNewSnapshot(PGLField field) OPENPGL_CATCH_BEGIN
+{
+    THROW_IF_NULL_OBJECT(field);
+    auto *gField = (IGuidingField *)field;
+    return (PGLField)gField->newSnapshot();
+}
+OPENPGL_CATCH_END(nullptr)
+
 extern "C" OPENPGL_DLLEXPORT void pglFieldReset(PGLField field) OPENPGL_CATCH_BEGIN
 {
     auto *gField = (IGuidingField *)field;
@@ -215,6 +283,16 @@ extern "C" OPENPGL_DLLEXPORT bool pglFieldInitSurfaceSamplingDistribution(PGLFie
     ISurfaceSamplingDistribution *gSurfaceSamplingDistribution = (ISurfaceSamplingDistribution *)surfaceSamplingDistribution;
     return gField->initSurfaceSamplingDistribution(gSurfaceSamplingDistribution, pos, sample1D);
 }
+
+extern "C" OPENPGL_DLLEXPORT void pglFieldInitSurfaceSamplingDistributions(PGLField field, PGLSurfaceSamplingDistribution *surfaceSamplingDistributions, const pgl_point3f *positions,
+                                                                           float *sample1Ds, bool *initialized, size_t numDistributions)
+{
+    static_assert(sizeof(openpgl::Point3) == sizeof(pgl_point3f), "Point3 and pgl_point3f must have the same layout");
+    auto *gField = (IGuidingField *)field;
+    gField->initSurfaceSamplingDistributions((ISurfaceSamplingDistribution **)surfaceSamplingDistributions, (const openpgl::Point3 *)positions, sample1Ds, initialized,
+                                             numDistributions);
+}
+
 extern "C" OPENPGL_DLLEXPORT PGLVolumeSamplingDistribution pglFieldNewVolumeSamplingDistribution(PGLField field) OPENPGL_CATCH_BEGIN
 {
     auto *gField = (IGuidingField *)field;
@@ -232,6 +310,15 @@ extern "C" OPENPGL_DLLEXPORT bool pglFieldInitVolumeSamplingDistribution(PGLFiel
     return gField->initVolumeSamplingDistribution(gVolumeSamplingDistribution, pos, sample1D);
 }
 
+extern "C" OPENPGL_DLLEXPORT void pglFieldInitVolumeSamplingDistributions(PGLField field, PGLVolumeSamplingDistribution *volumeSamplingDistributions, const pgl_point3f *positions,
+                                                                          float *sample1Ds, bool *initialized, size_t numDistributions)
+{
+    static_assert(sizeof(openpgl::Point3) == sizeof(pgl_point3f), "Point3 and pgl_point3f must have the same layout");
+    auto *gField = (IGuidingField *)field;
+    gField->initVolumeSamplingDistributions((IVolumeSamplingDistribution **)volumeSamplingDistributions, (const openpgl::Point3 *)positions, sample1Ds, initialized,
+                                            numDistributions);
+}
+
 extern "C" OPENPGL_DLLEXPORT bool pglFieldValidate(PGLField field)
 {
     const auto *gField = (const IGuidingField *)field;
@@ -782,10 +869,21 @@ extern "C" OPENPGL_DLLEXPORT void pglFieldArgumentsSetDefaults(PGLFieldArguments
             fieldArguments.spatialSturctureArguments = new PGLKDTreeArguments();
             reinterpret_cast<PGLKDTreeArguments *>(fieldArguments.spatialSturctureArguments)->maxSamples = maxSamplesPerLeaf;
             break;
+        case PGL_SPATIAL_STRUCTURE_TYPE::PGL_SPATIAL_STRUCTURE_KDTREE_WIDE:
+            fieldArguments.spatialStructureType = PGL_SPATIAL_STRUCTURE_KDTREE_WIDE;
+            fieldArguments.spatialSturctureArguments = new PGLKDTreeArguments();
+            reinterpret_cast<PGLKDTreeArguments *>(fieldArguments.spatialSturctureArguments)->maxSamples = maxSamplesPerLeaf;
+            break;
+        case PGL_SPATIAL_STRUCTURE_TYPE::PGL_SPATIAL_STRUCTURE_KDTREE_GRID:
+            fieldArguments.spatialStructureType = PGL_SPATIAL_STRUCTURE_KDTREE_GRID;
+            fieldArguments.spatialSturctureArguments = new PGLKDTreeArguments();
+            reinterpret_cast<PGLKDTreeArguments *>(fieldArguments.spatialSturctureArguments)->maxSamples = maxSamplesPerLeaf;
+            break;
     }
 
     fieldArguments.deterministic = deterministic;
     fieldArguments.debugArguments.fitRegions = true;
+    fieldArguments.debugArguments.profiling = false;
 
     switch (directionalType)
     {
@@ -848,6 +946,17 @@ extern "C" OPENPGL_DLLEXPORT PGLString pglFieldStatisticsToCSVString(PGLFieldSta
     return pglStr;
 }
 
+extern "C" OPENPGL_DLLEXPORT PGLString pglFieldStatisticsToJSONString(PGLFieldStatistics fieldStatistics)
+{
+    auto *gFieldStatistics = (openpgl::FieldStatistics *)fieldStatistics;
+    std::string str = gFieldStatistics->toJSONString();
+    PGLString pglStr;
+    pglStr.m_size = str.length() + 1;
+    pglStr.m_str = new char[pglStr.m_size];
+    strcpy(pglStr.m_str, str.c_str());
+    return pglStr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // String /////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -3,9 +3,9 @@
 namespace openpgl
 {
 
-IDevice *newDeviceCPU16(size_t numThreads)
+IDevice *newDeviceCPU16(size_t numThreads, int numaNode)
 {
-    return (IDevice *)new Device<16>(numThreads);
+    return (IDevice *)new Device<16>(numThreads, numaNode);
 }
 
 }  // namespace openpgl
\ No newline at end of file
@@ -3,9 +3,9 @@
 namespace openpgl
 {
 
-IDevice *newDeviceCPU4(size_t numThreads)
+IDevice *newDeviceCPU4(size_t numThreads, int numaNode)
 {
-    return (IDevice *)new Device<4>(numThreads);
+    return (IDevice *)new Device<4>(numThreads, numaNode);
 }
 
 }  // namespace openpgl
\ No newline at end of file
@@ -3,9 +3,9 @@
 namespace openpgl
 {
 
-IDevice *newDeviceCPU8(size_t numThreads)
+IDevice *newDeviceCPU8(size_t numThreads, int numaNode)
 {
-    return (IDevice *)new Device<8>(numThreads);
+    return (IDevice *)new Device<8>(numThreads, numaNode);
 }
 
 }  // namespace openpgl
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <iterator>
 
@@ -175,8 +176,11 @@ struct ContainerInternal
     {
         if (size > m_maxSize)
         {
+            // keeps the current elements (e.g., when samples are appended)
+            Type *data = new Type[size];
+            std::copy(m_data, m_data + m_size, data);
             delete[] m_data;
-            m_data = new Type[size];
+            m_data = data;
             m_maxSize = size;
         }
     }
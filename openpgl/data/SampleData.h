@@ -8,9 +8,11 @@
 #include "../include/openpgl/compression.h"
 #endif
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include "../include/openpgl/data.h"
 
@@ -152,6 +154,117 @@ inline bool SampleDataLess(const PGLSampleData &compA, const PGLSampleData &comp
                                                     )))))))))));
 }
 
+// maps a float to an unsigned integer with the same ordering (-0 and +0 are mapped to the same key)
+inline uint32_t FloatToOrderedKey(float f)
+{
+    if (f == 0.f)
+        f = 0.f;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(float));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// scratch memory of RadixSortSampleData, it is owned by the caller (e.g., one per thread
+// and update) so that it is released once the samples of an update are sorted
+struct RadixSortSampleDataBuffer
+{
+    typedef std::pair<uint64_t, uint32_t> KeyIndex;
+    std::vector<KeyIndex> keys;
+    std::vector<KeyIndex> keysTmp;
+};
+
+// sorts the samples into the same order as std::sort using SampleDataLess but without
+// the costs of the nested comparisons: the samples are sorted using a LSD radix sort on a
+// key packing the first two criteria of SampleDataLess (weight and pdf) and only the
+// (rare) runs of samples with equal keys are sorted using SampleDataLess afterwards
+inline void RadixSortSampleData(SampleData *samples, const size_t numSamples, RadixSortSampleDataBuffer &buffer)
+{
+    // for small ranges the comparison sort is faster than the radix sort passes
+    if (numSamples <= 64)
+    {
+        std::sort(samples, samples + numSamples, SampleDataLess);
+        return;
+    }
+
+    typedef RadixSortSampleDataBuffer::KeyIndex KeyIndex;
+    std::vector<KeyIndex> &keys = buffer.keys;
+    std::vector<KeyIndex> &keysTmp = buffer.keysTmp;
+    keys.resize(numSamples);
+    keysTmp.resize(numSamples);
+
+    uint64_t keyAnd = ~uint64_t(0);
+    uint64_t keyOr = 0;
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const uint64_t key = (uint64_t(FloatToOrderedKey(samples[i].weight)) << 32) | uint64_t(FloatToOrderedKey(samples[i].pdf));
+        keys[i] = KeyIndex(key, uint32_t(i));
+        keyAnd &= key;
+        keyOr |= key;
+    }
+
+    // 8 passes over 8-bit digits, passes where all keys share the same digit are skipped
+    const uint64_t varyingBits = keyAnd ^ keyOr;
+    size_t counts[256];
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        if (((varyingBits >> shift) & 0xFF) == 0)
+            continue;
+        std::fill(counts, counts + 256, 0);
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            counts[(keys[i].first >> shift) & 0xFF]++;
+        }
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++)
+        {
+            const size_t count = counts[d];
+            counts[d] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            keysTmp[counts[(keys[i].first >> shift) & 0xFF]++] = keys[i];
+        }
+        keys.swap(keysTmp);
+    }
+
+    // moves the samples into the sorted order by following the cycles of the permutation,
+    // the indices of the placed samples are reset to mark them as done
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        if (keys[i].second == i)
+            continue;
+        const SampleData sample = samples[i];
+        size_t j = i;
+        while (true)
+        {
+            const size_t k = keys[j].second;
+            keys[j].second = uint32_t(j);
+            if (k == i)
+            {
+                samples[j] = sample;
+                break;
+            }
+            samples[j] = samples[k];
+            j = k;
+        }
+    }
+
+    // resolve the ties using the remaining criteria of SampleDataLess
+    size_t runBegin = 0;
+    for (size_t i = 1; i <= numSamples; i++)
+    {
+        if (i == numSamples || keys[i].first != keys[runBegin].first)
+        {
+            if (i - runBegin > 1)
+            {
+                std::sort(samples + runBegin, samples + i, SampleDataLess);
+            }
+            runBegin = i;
+        }
+    }
+}
+
 inline bool ZeroValueSampleDataEqual(const PGLZeroValueSampleData &compA, const PGLZeroValueSampleData &compB)
 {
     if (compA.position.x != compB.position.x || compA.position.y != compB.position.y || compA.position.z != compB.position.z ||
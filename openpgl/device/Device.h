@@ -17,79 +17,65 @@
 #include "spatial/kdtree/KDTreeBuilder.h"
 #include "tbb/tbb.h"
 
-#define OPENPGL_TASK_CONTROL
-
 namespace openpgl
 {
 
-#ifdef OPENPGL_TASK_CONTROL
-#if TBB_INTERFACE_VERSION >= 11005
-static tbb::global_control *g_opgl_tbb_thread_control = nullptr;
-#else
-static tbb::task_scheduler_init g_opgl_tbb_threads(tbb::task_scheduler_init::deferred);
-#endif
-#endif
-
 struct IDevice
 {
     virtual ~IDevice(){};
     virtual ISurfaceVolumeField *newField(PGLFieldArguments args) const = 0;
     virtual ISurfaceVolumeField *newFieldFromFile(const std::string fieldFileName) const = 0;
+    virtual ISurfaceVolumeField *newFieldReplica(ISurfaceVolumeField *field) const = 0;
 };
 
 template <int VecSize>
 struct Device : public IDevice
 {
    private:
-#ifdef OPENPGL_TASK_CONTROL
     size_t m_numThreads{0};
-#endif
+    // the task arena all fields created by this device execute their updates in,
+    // using a per device arena instead of a global thread limit does not
+    // interfere with the parallelism of the application or other devices
+    std::shared_ptr<tbb::task_arena> m_arena;
+
    public:
-    Device(size_t numThreads = 0)
+    // if numaNode is a valid NUMA node id (and supported by the used TBB version)
+    // the threads of the device's arena are pinned to this node, otherwise it is ignored
+    Device(size_t numThreads = 0, int numaNode = -1)
     {
-#ifdef OPENPGL_TASK_CONTROL
-        if (numThreads == 0)
+#if TBB_INTERFACE_VERSION >= 12020
+        tbb::task_arena::constraints constraints;
+        const std::vector<tbb::numa_node_id> numaNodes = tbb::info::numa_nodes();
+        if (numaNode >= 0 && std::find(numaNodes.begin(), numaNodes.end(), numaNode) != numaNodes.end())
         {
-#if TBB_INTERFACE_VERSION >= 9100
-            m_numThreads = tbb::this_task_arena::max_concurrency();
-#else
-            m_numThreads = tbb::task_scheduler_init::default_num_threads();
-#endif
+            constraints.numa_id = numaNode;
         }
-        else
-        {
-#if TBB_INTERFACE_VERSION >= 9100
-            m_numThreads = std::min(numThreads, (size_t)tbb::this_task_arena::max_concurrency());
+        const size_t maxNumThreads = tbb::info::default_concurrency(constraints.numa_id);
+#elif TBB_INTERFACE_VERSION >= 9100
+        const size_t maxNumThreads = tbb::this_task_arena::max_concurrency();
 #else
-            m_numThreads = std::min(numThreads, (size_t)tbb::task_scheduler_init::default_num_threads());
+        const size_t maxNumThreads = tbb::task_scheduler_init::default_num_threads();
 #endif
-        }
-#if TBB_INTERFACE_VERSION >= 11005
-        g_opgl_tbb_thread_control = new tbb::global_control(tbb::global_control::max_allowed_parallelism, m_numThreads);
+        m_numThreads = numThreads == 0 ? maxNumThreads : std::min(numThreads, maxNumThreads);
+#if TBB_INTERFACE_VERSION >= 12020
+        constraints.max_concurrency = int(m_numThreads);
+        m_arena = std::make_shared<tbb::task_arena>(constraints);
 #else
-        g_opgl_tbb_threads.initialize(int(m_numThreads));
-#endif
+        m_arena = std::make_shared<tbb::task_arena>(int(m_numThreads));
 #endif
         VMMSingleLobeHenyeyGreensteinOracle::init();
     }
 
-    ~Device() override
-    {
-#ifdef OPENPGL_TASK_CONTROL
-#if TBB_INTERFACE_VERSION >= 11005
-        delete g_opgl_tbb_thread_control;
-        g_opgl_tbb_thread_control = nullptr;
-#else
-        g_opgl_tbb_threads.terminate();
-#endif
-#endif
-    }
+    ~Device() override {}
 
     ISurfaceVolumeField *newField(PGLFieldArguments args) const override
     {
         ISurfaceVolumeField *gField;
+        // the wide and grid KD-tree types use the same builder and only differ in the structure used for the look-ups
+        const bool isKDTree = args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE || args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_WIDE ||
+                              args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_GRID;
 
-        if (args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_PARALLAX_AWARE_VMM)
+        if (isKDTree && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_PARALLAX_AWARE_VMM)
         {
             using DirectionalDistributionFactory = AdaptiveSplitAndMergeFactory<ParallaxAwareVonMisesFisherMixture<VecSize, 32, true>>;
             using GuidingField = SurfaceVolumeField<VecSize, DirectionalDistributionFactory, KDTreePartitionBuilder,
@@ -100,6 +86,7 @@ struct Device : public IDevice
             gFieldSettings.settings.decayOnSpatialSplit = 0.25f;
             gFieldSettings.settings.deterministic = args.deterministic;
             gFieldSettings.debugSettings.fitRegions = args.debugArguments.fitRegions;
+            gFieldSettings.debugSettings.profiling = args.debugArguments.profiling;
 
             PGLKDTreeArguments *spatialSturctureArguments = (PGLKDTreeArguments *)args.spatialSturctureArguments;
             gFieldSettings.settings.useStochasticNNLookUp = spatialSturctureArguments->knnLookup;
@@ -107,6 +94,16 @@ struct Device : public IDevice
             gFieldSettings.settings.spatialSubdivBuilderSettings.minSamples = spatialSturctureArguments->minSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxSamples = spatialSturctureArguments->maxSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxDepth = spatialSturctureArguments->maxDepth;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.numSplitBins = spatialSturctureArguments->numSplitBins;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.mortonBuild = spatialSturctureArguments->mortonBuild;
+            gFieldSettings.settings.sceneBoundsTrimPercentile = spatialSturctureArguments->sceneBoundsTrimPercentile;
+            gFieldSettings.settings.sceneBoundsEnlargement = spatialSturctureArguments->sceneBoundsEnlargement;
+            gFieldSettings.settings.memoryBudget = spatialSturctureArguments->memoryBudget;
+            gFieldSettings.settings.spatialStructureType = args.spatialStructureType;
+            gFieldSettings.settings.useLookUpCache = spatialSturctureArguments->lookUpCache;
+            gFieldSettings.settings.knnUpdateTolerance = spatialSturctureArguments->knnUpdateTolerance;
+            gFieldSettings.settings.knnNumNeighbours = spatialSturctureArguments->knnNumNeighbours;
+            gFieldSettings.settings.knnK = spatialSturctureArguments->knnK;
             delete spatialSturctureArguments;
 
             PGLVMMFactoryArguments *directionalDistributionArguments = (PGLVMMFactoryArguments *)args.directionalDistributionArguments;
@@ -136,9 +133,9 @@ struct Device : public IDevice
             gFieldSettings.distributionFactorySettings.minSamplesForMerging = directionalDistributionArguments->minSamplesForMerging;
             delete directionalDistributionArguments;
 
-            gField = new GuidingField(gFieldSettings);
+            gField = new GuidingField(gFieldSettings, m_arena);
         }
-        else if (args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_VMM)
+        else if (isKDTree && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_VMM)
         {
             using DirectionalDistributionFactory = AdaptiveSplitAndMergeFactory<ParallaxAwareVonMisesFisherMixture<VecSize, 32, false>>;
             using GuidingField = SurfaceVolumeField<VecSize, DirectionalDistributionFactory, KDTreePartitionBuilder,
@@ -149,6 +146,7 @@ struct Device : public IDevice
             gFieldSettings.settings.decayOnSpatialSplit = 0.25f;
             gFieldSettings.settings.deterministic = args.deterministic;
             gFieldSettings.debugSettings.fitRegions = args.debugArguments.fitRegions;
+            gFieldSettings.debugSettings.profiling = args.debugArguments.profiling;
 
             PGLKDTreeArguments *spatialSturctureArguments = (PGLKDTreeArguments *)args.spatialSturctureArguments;
             gFieldSettings.settings.useStochasticNNLookUp = spatialSturctureArguments->knnLookup;
@@ -156,6 +154,16 @@ struct Device : public IDevice
             gFieldSettings.settings.spatialSubdivBuilderSettings.minSamples = spatialSturctureArguments->minSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxSamples = spatialSturctureArguments->maxSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxDepth = spatialSturctureArguments->maxDepth;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.numSplitBins = spatialSturctureArguments->numSplitBins;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.mortonBuild = spatialSturctureArguments->mortonBuild;
+            gFieldSettings.settings.sceneBoundsTrimPercentile = spatialSturctureArguments->sceneBoundsTrimPercentile;
+            gFieldSettings.settings.sceneBoundsEnlargement = spatialSturctureArguments->sceneBoundsEnlargement;
+            gFieldSettings.settings.memoryBudget = spatialSturctureArguments->memoryBudget;
+            gFieldSettings.settings.spatialStructureType = args.spatialStructureType;
+            gFieldSettings.settings.useLookUpCache = spatialSturctureArguments->lookUpCache;
+            gFieldSettings.settings.knnUpdateTolerance = spatialSturctureArguments->knnUpdateTolerance;
+            gFieldSettings.settings.knnNumNeighbours = spatialSturctureArguments->knnNumNeighbours;
+            gFieldSettings.settings.knnK = spatialSturctureArguments->knnK;
             delete spatialSturctureArguments;
 
             PGLVMMFactoryArguments *directionalDistributionArguments = (PGLVMMFactoryArguments *)args.directionalDistributionArguments;
@@ -185,9 +193,9 @@ struct Device : public IDevice
             gFieldSettings.distributionFactorySettings.minSamplesForMerging = directionalDistributionArguments->minSamplesForMerging;
             delete directionalDistributionArguments;
 
-            gField = new GuidingField(gFieldSettings);
+            gField = new GuidingField(gFieldSettings, m_arena);
         }
-        else if (args.spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_QUADTREE)
+        else if (isKDTree && args.directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_QUADTREE)
         {
             using DirectionalDistributionFactory = DirectionalQuadtreeFactory<DirectionalQuadtree<SphereToSquareCylindrical>>;
             using GuidingField =
@@ -198,6 +206,7 @@ struct Device : public IDevice
             gFieldSettings.settings.decayOnSpatialSplit = 0.25f;
             gFieldSettings.settings.deterministic = args.deterministic;
             gFieldSettings.debugSettings.fitRegions = args.debugArguments.fitRegions;
+            gFieldSettings.debugSettings.profiling = args.debugArguments.profiling;
 
             PGLKDTreeArguments *spatialSturctureArguments = (PGLKDTreeArguments *)args.spatialSturctureArguments;
             gFieldSettings.settings.useStochasticNNLookUp = spatialSturctureArguments->knnLookup;
@@ -205,6 +214,16 @@ struct Device : public IDevice
             gFieldSettings.settings.spatialSubdivBuilderSettings.minSamples = spatialSturctureArguments->minSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxSamples = spatialSturctureArguments->maxSamples;
             gFieldSettings.settings.spatialSubdivBuilderSettings.maxDepth = spatialSturctureArguments->maxDepth;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.numSplitBins = spatialSturctureArguments->numSplitBins;
+            gFieldSettings.settings.spatialSubdivBuilderSettings.mortonBuild = spatialSturctureArguments->mortonBuild;
+            gFieldSettings.settings.sceneBoundsTrimPercentile = spatialSturctureArguments->sceneBoundsTrimPercentile;
+            gFieldSettings.settings.sceneBoundsEnlargement = spatialSturctureArguments->sceneBoundsEnlargement;
+            gFieldSettings.settings.memoryBudget = spatialSturctureArguments->memoryBudget;
+            gFieldSettings.settings.spatialStructureType = args.spatialStructureType;
+            gFieldSettings.settings.useLookUpCache = spatialSturctureArguments->lookUpCache;
+            gFieldSettings.settings.knnUpdateTolerance = spatialSturctureArguments->knnUpdateTolerance;
+            gFieldSettings.settings.knnNumNeighbours = spatialSturctureArguments->knnNumNeighbours;
+            gFieldSettings.settings.knnK = spatialSturctureArguments->knnK;
 
             PGLDQTFactoryArguments *directionalDistributionArguments = (PGLDQTFactoryArguments *)args.directionalDistributionArguments;
             gFieldSettings.distributionFactorySettings.leafEstimator = (LeafEstimator)directionalDistributionArguments->leafEstimator;
@@ -213,7 +232,7 @@ struct Device : public IDevice
             gFieldSettings.distributionFactorySettings.footprintFactor = directionalDistributionArguments->footprintFactor;
             gFieldSettings.distributionFactorySettings.maxLevels = directionalDistributionArguments->maxLevels;
 
-            gField = new GuidingField(gFieldSettings);
+            gField = new GuidingField(gFieldSettings, m_arena);
         }
         else
         {
@@ -250,33 +269,41 @@ struct Device : public IDevice
         is.read(reinterpret_cast<char *>(&directionalDistributionType), sizeof(directionalDistributionType));
 
         ISurfaceVolumeField *gField;
+        const bool isKDTree = spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE || spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_WIDE ||
+                              spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_GRID;
 
-        if (spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_PARALLAX_AWARE_VMM)
+        if (isKDTree && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_PARALLAX_AWARE_VMM)
         {
             using DirectionalDistributionFactory = AdaptiveSplitAndMergeFactory<ParallaxAwareVonMisesFisherMixture<VecSize, 32, true>>;
             using GuidingField = SurfaceVolumeField<VecSize, DirectionalDistributionFactory, KDTreePartitionBuilder,
                                                     VMMSurfaceSamplingDistribution<typename DirectionalDistributionFactory::Distribution, true>,
                                                     VMMVolumeSamplingDistribution<typename DirectionalDistributionFactory::Distribution, true>>;
 
-            gField = (ISurfaceVolumeField *)new GuidingField();
+            GuidingField *field = new GuidingField(m_arena);
+            field->setSpatialStructureType(spatialStructureType);
+            gField = (ISurfaceVolumeField *)field;
         }
-        else if (spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_VMM)
+        else if (isKDTree && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_VMM)
         {
             using DirectionalDistributionFactory = AdaptiveSplitAndMergeFactory<ParallaxAwareVonMisesFisherMixture<VecSize, 32, false>>;
             using GuidingField = SurfaceVolumeField<VecSize, DirectionalDistributionFactory, KDTreePartitionBuilder,
                                                     VMMSurfaceSamplingDistribution<typename DirectionalDistributionFactory::Distribution, false>,
                                                     VMMVolumeSamplingDistribution<typename DirectionalDistributionFactory::Distribution, false>>;
 
-            gField = (ISurfaceVolumeField *)new GuidingField();
+            GuidingField *field = new GuidingField(m_arena);
+            field->setSpatialStructureType(spatialStructureType);
+            gField = (ISurfaceVolumeField *)field;
         }
-        else if (spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_QUADTREE)
+        else if (isKDTree && directionalDistributionType == PGL_DIRECTIONAL_DISTRIBUTION_QUADTREE)
         {
             using DirectionalDistributionFactory = DirectionalQuadtreeFactory<DirectionalQuadtree<SphereToSquareCylindrical>>;
             using GuidingField =
                 SurfaceVolumeField<VecSize, DirectionalDistributionFactory, KDTreePartitionBuilder, DQTSurfaceSamplingDistribution<DirectionalDistributionFactory::Distribution>,
                                    DQTVolumeSamplingDistribution<DirectionalDistributionFactory::Distribution>>;
 
-            gField = (ISurfaceVolumeField *)new GuidingField();
+            GuidingField *field = new GuidingField(m_arena);
+            field->setSpatialStructureType(spatialStructureType);
+            gField = (ISurfaceVolumeField *)field;
         }
         else
         {
@@ -284,22 +311,37 @@ struct Device : public IDevice
             throw std::runtime_error("error: unrecognized field type");
         }
 
-        gField->deserialize(is);
+        // loading inside the arena places the field's memory on the device's NUMA node (first-touch)
+        try
+        {
+            m_arena->execute([&]() { gField->deserialize(is); });
+        }
+        catch (...)
+        {
+            delete gField;
+            fb.close();
+            throw;
+        }
 
         fb.close();
 
         return gField;
     }
+
+    ISurfaceVolumeField *newFieldReplica(ISurfaceVolumeField *field) const override
+    {
+        return field->newReplica(m_arena);
+    }
 };
 
 #ifdef OPENPGL_DEVICE_TYPE_CPU_4
-IDevice *newDeviceCPU4(size_t numThreads = 0);
+IDevice *newDeviceCPU4(size_t numThreads = 0, int numaNode = -1);
 #endif
 #ifdef OPENPGL_DEVICE_TYPE_CPU_8
-IDevice *newDeviceCPU8(size_t numThreads = 0);
+IDevice *newDeviceCPU8(size_t numThreads = 0, int numaNode = -1);
 #endif
 #ifdef OPENPGL_DEVICE_TYPE_CPU_16
-IDevice *newDeviceCPU16(size_t numThreads = 0);
+IDevice *newDeviceCPU16(size_t numThreads = 0, int numaNode = -1);
 #endif
 
 }  // namespace openpgl
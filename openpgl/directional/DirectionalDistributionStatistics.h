@@ -58,5 +58,18 @@ struct DirectionalDistributionStatistics
         ss << tab << "secondMomentNumberOfComponents   = " << secondMomentNumberOfComponents << std::endl;
         return ss.str();
     }
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "{";
+        ss << "\"sizePerDistribution\": " << sizePerDistribution;
+        ss << ", \"minNumberOfComponents\": " << jsonNumber(minNumberOfComponents);
+        ss << ", \"maxNumberOfComponents\": " << jsonNumber(maxNumberOfComponents);
+        ss << ", \"averageNumberOfComponents\": " << jsonNumber(averageNumberOfComponents);
+        ss << ", \"secondMomentNumberOfComponents\": " << jsonNumber(secondMomentNumberOfComponents);
+        ss << "}";
+        return ss.str();
+    }
 };
 }  // namespace openpgl
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "../spatial/IRegion.h"
 
 namespace openpgl
@@ -57,9 +59,22 @@ struct ISurfaceSamplingDistribution
 
     virtual const IRegion *getRegion() const = 0;
 
+    // keeps the memory of the region alive (e.g., the buffer of an asynchronously updated field)
+    // until the distribution is initialized from another one or destroyed
+    const void *getRegionOwner() const
+    {
+        return m_regionOwner.get();
+    };
+
+    void setRegionOwner(const std::shared_ptr<const void> &regionOwner)
+    {
+        m_regionOwner = regionOwner;
+    };
+
    protected:
     // const IRegion* m_region {nullptr};
     uint32_t m_id{0};
+    std::shared_ptr<const void> m_regionOwner;
 };
 
 }  // namespace openpgl
\ No newline at end of file
@@ -167,6 +167,15 @@ class DirectionalQuadtreeFactory
         uint32_t numNodes = 0;
         uint32_t numSplits = 0;
         uint32_t numMerges = 0;
+
+        // the quadtree is not fitted using EM, these members only exist to match
+        // the interface of the other factories (e.g., for the profiling of the field)
+        size_t numUpdateWEMIterations{0};
+        size_t numPartialUpdateWEMIterations{0};
+        float timeEM{0.f};
+        float timeSplit{0.f};
+        float timeMerge{0.f};
+        float timeDistanceUpdate{0.f};
     };
 
     void prepareSamples(SampleData *samples, const size_t numSamples, const SampleStatistics &sampleStatistics, const Configuration &cfg) const {}
@@ -215,6 +224,20 @@ class DirectionalQuadtreeFactory
             updateInternal<LeafEstimator::PER_LEAF, SplitMetric::SECOND_MOMENT, true>(ctx);
     }
 
+    // merges the quadtree and the statistics of another region into dist and stats, e.g., when two regions of the
+    // spatial structure are collapsed into one, the statistics of both quadtrees are accumulated into the union of
+    // both trees and the quadtree is rebuilt from the merged statistics
+    void merge(Distribution &dist, Statistics &stats, const Distribution &otherDist, const Statistics &otherStats, const Configuration &cfg)
+    {
+        std::vector<StatsNode> nodes = {StatsNode()};
+        mergeRecursive(nodes, 0, stats.nodes, 0, 1.f, otherStats.nodes, 0, 1.f);
+        stats.nodes = std::move(nodes);
+        stats.numSamples += otherStats.numSamples;
+
+        FittingStatistics fitStats;
+        update(dist, stats, nullptr, 0, cfg, fitStats);
+    }
+
    private:
     struct Context
     {
@@ -359,6 +382,31 @@ class DirectionalQuadtreeFactory
         }
     }
 
+    // the statistics of a leaf which is merged with an inner node are distributed evenly over its children (see buildSplit)
+    void mergeRecursive(std::vector<StatsNode> &nodes, uint32_t j, const std::vector<StatsNode> &nodesA, uint32_t a, float scaleA, const std::vector<StatsNode> &nodesB,
+                        uint32_t b, float scaleB) const
+    {
+        const StatsNode &nodeA = nodesA[a];
+        const StatsNode &nodeB = nodesB[b];
+        if (nodeA.offsetChildren > 0 || nodeB.offsetChildren > 0)
+        {
+            const uint32_t offsetChildren = nodes.size();
+            nodes[j].offsetChildren = offsetChildren;
+            for (uint32_t c = 0; c < 4; c++)
+                nodes.emplace_back();
+            for (uint32_t c = 0; c < 4; c++)
+                mergeRecursive(nodes, offsetChildren + c, nodesA, nodeA.offsetChildren > 0 ? nodeA.offsetChildren + c : a, nodeA.offsetChildren > 0 ? scaleA : scaleA / 4,
+                               nodesB, nodeB.offsetChildren > 0 ? nodeB.offsetChildren + c : b, nodeB.offsetChildren > 0 ? scaleB : scaleB / 4);
+        }
+        else
+        {
+            StatsNode &node = nodes[j];
+            node.numSamples = scaleA * nodeA.numSamples + scaleB * nodeB.numSamples;
+            node.firstMoment = scaleA * nodeA.firstMoment + scaleB * nodeB.firstMoment;
+            node.secondMoment = scaleA * nodeA.secondMoment + scaleB * nodeB.secondMoment;
+        }
+    }
+
     void buildSplit(Context &ctx, Rect<float> rect, uint32_t p, uint32_t i, uint32_t level)
     {
         const auto &parent = ctx.stats->nodes[p];
@@ -111,6 +111,12 @@ struct AdaptiveSplitAndMergeFactory
         size_t numUpdateWEMIterations{0};
         size_t numPartialUpdateWEMIterations{0};
 
+        // time (ms) spend in the different fitting steps
+        float timeEM{0.f};
+        float timeSplit{0.f};
+        float timeMerge{0.f};
+        float timeDistanceUpdate{0.f};
+
         std::string toString() const;
     };
 
@@ -122,6 +128,10 @@ struct AdaptiveSplitAndMergeFactory
 
     void updateFluenceEstimate(VMM &vmm, const SampleData *samples, const size_t numSamples, const size_t numZeroValueSamples, const SampleStatistics &sampleStatistics) const;
 
+    // merges the mixture and the statistics of another region (with the same pivot position) into vmm and stats,
+    // e.g., when two regions of the spatial structure are collapsed into one
+    void merge(VMM &vmm, Statistics &stats, const VMM &otherVMM, const Statistics &otherStats, const Configuration &cfg) const;
+
     std::string toString() const
     {
         std::ostringstream oss;
@@ -202,6 +212,10 @@ std::string AdaptiveSplitAndMergeFactory<TVMMDistribution>::FittingStatistics::t
     ss << "\tnumComponents:" << numComponents << std::endl;
     ss << "\tnumUpdateWEMIterations:" << numUpdateWEMIterations << std::endl;
     ss << "\tnumPartialUpdateWEMIterations:" << numPartialUpdateWEMIterations << std::endl;
+    ss << "\ttimeEM:" << timeEM << std::endl;
+    ss << "\ttimeSplit:" << timeSplit << std::endl;
+    ss << "\ttimeMerge:" << timeMerge << std::endl;
+    ss << "\ttimeDistanceUpdate:" << timeDistanceUpdate << std::endl;
     return ss.str();
 }
 
@@ -304,8 +318,14 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::fit(VMM &vmm, Statistics &s
     // intial fit
     WeightedEMFactory factory = WeightedEMFactory();
     typename WeightedEMFactory::FittingStatistics wemFitStats;
+    Timer stepTimer;
     factory.fitMixture(vmm, stats.sufficientStatistics, samples, numSamples, cfg.weightedEMCfg, wemFitStats);
+    fitStats.numSamples = numSamples;
+    fitStats.numUpdateWEMIterations = wemFitStats.numIterations;
+    fitStats.timeEM += stepTimer.elapsed() * 1e-3f;
+    stepTimer.reset();
     factory.initComponentDistances(vmm, stats.sufficientStatistics, samples, numSamples);
+    fitStats.timeDistanceUpdate += stepTimer.elapsed() * 1e-3f;
     OPENPGL_ASSERT(vmm.isValid());
     OPENPGL_ASSERT(vmm.getNumComponents() == stats.sufficientStatistics.getNumComponents());
     OPENPGL_ASSERT(stats.isValid());
@@ -321,23 +341,30 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::fit(VMM &vmm, Statistics &s
 #ifdef OPENPGL_SHOW_PRINT_OUTS
         std::cout << stats.sufficientStatistics.toString() << std::endl;
 #endif
+        stepTimer.reset();
         Splitter splitter = Splitter();
         splitter.PerformRecursiveSplitting(vmm, stats.sufficientStatistics, cfg.splittingThreshold, mcEstimate, samples, numSamples, cfg.weightedEMCfg);
 
         splitter.CalculateSplitStatistics(vmm, stats.splittingStatistics, mcEstimate, samples, numSamples);
+        fitStats.timeSplit += stepTimer.elapsed() * 1e-3f;
 
         OPENPGL_ASSERT(vmm.getNumComponents() == stats.getNumComponents());
         OPENPGL_ASSERT(vmm.isValid());
 
+        stepTimer.reset();
         Merger merger = Merger();
-        merger.PerformMerging(vmm, cfg.mergingThreshold, stats.sufficientStatistics, stats.splittingStatistics);
+        fitStats.numMerges = merger.PerformMerging(vmm, cfg.mergingThreshold, stats.sufficientStatistics, stats.splittingStatistics);
+        fitStats.timeMerge += stepTimer.elapsed() * 1e-3f;
         OPENPGL_ASSERT(vmm.isValid());
     }
 
     stats.numSamplesAfterLastSplit = 0.0f;
     stats.numSamplesAfterLastMerge = 0.0f;
 
+    stepTimer.reset();
     factory.initComponentDistances(vmm, stats.sufficientStatistics, samples, numSamples);
+    fitStats.timeDistanceUpdate += stepTimer.elapsed() * 1e-3f;
+    fitStats.numComponents = vmm._numComponents;
     OPENPGL_ASSERT(stats.sufficientStatistics.isValid());
     OPENPGL_ASSERT(vmm.isValid());
 }
@@ -355,7 +382,11 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
     typename WeightedEMFactory::FittingStatistics wemFitStats;
     // stats.sufficientStatistics.clear(vmm._numComponents);
     const size_t prevNumberOfComponents = vmm._numComponents;
+    Timer stepTimer;
     factory.updateMixture(vmm, stats.sufficientStatistics, samples, numSamples, cfg.weightedEMCfg, wemFitStats);
+    fitStats.timeEM += stepTimer.elapsed() * 1e-3f;
+    fitStats.numSamples = numSamples;
+    fitStats.numUpdateWEMIterations = wemFitStats.numIterations;
     OPENPGL_ASSERT(vmm.isValid());
     // check if the update step added a new component.
     // This happnes if samples are not covered by any existing component
@@ -370,19 +401,19 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
     {
         float mcEstimate = stats.sufficientStatistics.getSumWeights() / stats.sufficientStatistics.getNumSamples();
 
-        fitStats.numSamples = numSamples;
-        fitStats.numUpdateWEMIterations = wemFitStats.numIterations;
-
         stats.numSamplesAfterLastSplit += numSamples;
         stats.numSamplesAfterLastMerge += numSamples;
 
+        stepTimer.reset();
         Splitter splitter = Splitter();
         // OPENPGL_ASSERT(stats.splittingStatistics.isValid());
         splitter.UpdateSplitStatistics(vmm, stats.splittingStatistics, mcEstimate, samples, numSamples);
         OPENPGL_ASSERT(stats.splittingStatistics.isValid());
+        fitStats.timeSplit += stepTimer.elapsed() * 1e-3f;
 
         if (stats.numSamplesAfterLastSplit >= cfg.minSamplesForSplitting)
         {
+            stepTimer.reset();
             typename WeightedEMFactory::PartialFittingMask mask;
             mask.resetToFalse();
 
@@ -404,9 +435,11 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
             OPENPGL_ASSERT(vmm.isValid());
             OPENPGL_ASSERT(vmm.getNumComponents() == stats.getNumComponents());
             OPENPGL_ASSERT(stats.isValid());
+            fitStats.timeSplit += stepTimer.elapsed() * 1e-3f;
 
             if (totalSplitCount > 0 && cfg.partialReFit && numSamples >= cfg.minSamplesForPartialRefitting)
             {
+                stepTimer.reset();
                 typename WeightedEMFactory::SufficientStatistics tempSuffStatistics = stats.sufficientStatistics;
                 tempSuffStatistics.clear(vmm._numComponents);
                 factory.partialUpdateMixture(vmm, mask, tempSuffStatistics, samples, numSamples, cfg.weightedEMCfg, wemFitStats);
@@ -416,6 +449,7 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
                 // account for additionaly added componetes based on not covered samples.
                 stats.splittingStatistics.setNumComponents(vmm._numComponents);
                 fitStats.numPartialUpdateWEMIterations = wemFitStats.numIterations;
+                fitStats.timeEM += stepTimer.elapsed() * 1e-3f;
                 OPENPGL_ASSERT(vmm.isValid());
                 OPENPGL_ASSERT(vmm.getNumComponents() == stats.getNumComponents());
                 OPENPGL_ASSERT(stats.isValid());
@@ -435,9 +469,11 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
 
         if (stats.numSamplesAfterLastMerge >= cfg.minSamplesForMerging)
         {
+            stepTimer.reset();
             Merger merger = Merger();
             size_t numMerges = merger.PerformMerging(vmm, cfg.mergingThreshold, stats.sufficientStatistics, stats.splittingStatistics);
             fitStats.numMerges = numMerges;
+            fitStats.timeMerge += stepTimer.elapsed() * 1e-3f;
             stats.numSamplesAfterLastMerge = 0.0f;
 
             OPENPGL_ASSERT(vmm.isValid());
@@ -448,7 +484,9 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::update(VMM &vmm, Statistics
         fitStats.numComponents = vmm._numComponents;
     }
     OPENPGL_ASSERT(vmm.isValid());
+    stepTimer.reset();
     factory.updateComponentDistances(vmm, stats.sufficientStatistics, samples, numSamples);
+    fitStats.timeDistanceUpdate += stepTimer.elapsed() * 1e-3f;
 
     OPENPGL_ASSERT(vmm.getNumComponents() == stats.sufficientStatistics.getNumComponents());
     OPENPGL_ASSERT(vmm.isValid());
@@ -463,4 +501,53 @@ void AdaptiveSplitAndMergeFactory<TVMMDistribution>::updateFluenceEstimate(VMM &
     factory.updateFluenceEstimate(vmm, samples, numSamples, numZeroValueSamples, sampleStatistics);
 }
 
+template <class TVMMDistribution>
+void AdaptiveSplitAndMergeFactory<TVMMDistribution>::merge(VMM &vmm, Statistics &stats, const VMM &otherVMM, const Statistics &otherStats, const Configuration &cfg) const
+{
+    OPENPGL_ASSERT(vmm.isValid() && otherVMM.isValid());
+    OPENPGL_ASSERT(stats.isValid() && otherStats.isValid());
+
+    VMM other = otherVMM;
+    Statistics statsOther = otherStats;
+
+    // merge the most similar components of the larger mixture until
+    // the components of both mixtures fit into one mixture
+    Merger merger = Merger();
+    while (vmm._numComponents + other._numComponents > VMM::MaxComponents)
+    {
+        const bool reduceOther = other._numComponents > vmm._numComponents;
+        float mergeCost = 0.0f;
+        if (!merger.ThresholdedMergeNext(reduceOther ? other : vmm, std::numeric_limits<float>::max(), mergeCost,
+                                         reduceOther ? statsOther.sufficientStatistics : stats.sufficientStatistics,
+                                         reduceOther ? statsOther.splittingStatistics : stats.splittingStatistics) &&
+            !merger.ThresholdedMergeNext(reduceOther ? vmm : other, std::numeric_limits<float>::max(), mergeCost,
+                                         reduceOther ? stats.sufficientStatistics : statsOther.sufficientStatistics,
+                                         reduceOther ? stats.splittingStatistics : statsOther.splittingStatistics))
+        {
+            // no merge candidates (i.e., components without samples), keep vmm as it is
+            return;
+        }
+    }
+
+    // weight the components of both mixtures by the number of samples they were fitted to
+    const float numSamples = stats.sufficientStatistics.getNumSamples();
+    const float numSamplesOther = statsOther.sufficientStatistics.getNumSamples();
+    const float weight = numSamples + numSamplesOther > 0.f ? numSamples / (numSamples + numSamplesOther) : 0.5f;
+    vmm.appendComponents(other, weight, 1.f - weight);
+    stats.sufficientStatistics.appendComponentStats(statsOther.sufficientStatistics);
+    stats.splittingStatistics.appendComponentStats(statsOther.splittingStatistics);
+    stats.numSamplesAfterLastSplit = std::min(stats.numSamplesAfterLastSplit, statsOther.numSamplesAfterLastSplit);
+    stats.numSamplesAfterLastMerge = std::min(stats.numSamplesAfterLastMerge, statsOther.numSamplesAfterLastMerge);
+
+    // merge the components of both mixtures which represent the same lobes
+    if (cfg.useSplitAndMerge)
+    {
+        merger.PerformMerging(vmm, cfg.mergingThreshold, stats.sufficientStatistics, stats.splittingStatistics);
+    }
+
+    OPENPGL_ASSERT(vmm.isValid());
+    OPENPGL_ASSERT(vmm.getNumComponents() == stats.getNumComponents());
+    OPENPGL_ASSERT(stats.isValid());
+}
+
 }  // namespace openpgl
@@ -109,6 +109,10 @@ struct ParallaxAwareVonMisesFisherMixture
 
     void performRelativeParallaxShift(const Vector3 &shiftDirection);
 
+    // appends the components of another mixture (with the same pivot position), the weights of the
+    // components of this and the other mixture are scaled by weight and otherWeight
+    void appendComponents(const ParallaxAwareVonMisesFisherMixture &other, const float &weight, const float &otherWeight);
+
 #ifdef OPENPGL_RADIANCE_CACHES
     Vector3 incomingRadiance(const Vector3 &direction, const bool directLightMIS) const;
 
@@ -432,6 +436,64 @@ void ParallaxAwareVonMisesFisherMixture<VecSize, maxComponents, UseParallaxCompe
     }
 }
 
+template <int VecSize, int maxComponents, bool UseParallaxCompensation>
+void ParallaxAwareVonMisesFisherMixture<VecSize, maxComponents, UseParallaxCompensation>::appendComponents(const ParallaxAwareVonMisesFisherMixture &other, const float &weight,
+                                                                                                      const float &otherWeight)
+{
+    OPENPGL_ASSERT(_numComponents + other._numComponents <= MaxComponents);
+
+    const int cnt = (_numComponents + VecSize - 1) / VecSize;
+    const embree::vfloat<VecSize> weightVec(weight);
+    for (int k = 0; k < cnt; k++)
+    {
+        _weights[k] *= weightVec;
+    }
+
+#ifdef OPENPGL_RADIANCE_CACHES
+    // the fluence estimates are averages over the fluence samples of each mixture
+    const float numFluenceSamples = _numFluenceSamples + other._numFluenceSamples;
+    const float fluenceWeight = numFluenceSamples > 0.f ? _numFluenceSamples / numFluenceSamples : 0.5f;
+    const float otherFluenceWeight = 1.f - fluenceWeight;
+    const embree::vfloat<VecSize> fluenceWeightVec(fluenceWeight);
+    for (int k = 0; k < cnt; k++)
+    {
+        _fluenceRGBWeightsWithMIS[k] *= fluenceWeightVec;
+        _fluenceRGBWeights[k] *= fluenceWeightVec;
+    }
+    _fluenceRGB = _fluenceRGB * fluenceWeight + other._fluenceRGB * otherFluenceWeight;
+    _fluenceRGBWithMIS = _fluenceRGBWithMIS * fluenceWeight + other._fluenceRGBWithMIS * otherFluenceWeight;
+    _numFluenceSamples = numFluenceSamples;
+#endif
+
+    for (size_t i = 0; i < other._numComponents; i++)
+    {
+        const div_t tmpIdx0 = div(_numComponents + i, VecSize);
+        const div_t tmpIdx1 = div(i, VecSize);
+
+        _weights[tmpIdx0.quot][tmpIdx0.rem] = other._weights[tmpIdx1.quot][tmpIdx1.rem] * otherWeight;
+        _kappas[tmpIdx0.quot][tmpIdx0.rem] = other._kappas[tmpIdx1.quot][tmpIdx1.rem];
+        _eMinus2Kappa[tmpIdx0.quot][tmpIdx0.rem] = other._eMinus2Kappa[tmpIdx1.quot][tmpIdx1.rem];
+        _meanCosines[tmpIdx0.quot][tmpIdx0.rem] = other._meanCosines[tmpIdx1.quot][tmpIdx1.rem];
+        _normalizations[tmpIdx0.quot][tmpIdx0.rem] = other._normalizations[tmpIdx1.quot][tmpIdx1.rem];
+
+        _meanDirections[tmpIdx0.quot].x[tmpIdx0.rem] = other._meanDirections[tmpIdx1.quot].x[tmpIdx1.rem];
+        _meanDirections[tmpIdx0.quot].y[tmpIdx0.rem] = other._meanDirections[tmpIdx1.quot].y[tmpIdx1.rem];
+        _meanDirections[tmpIdx0.quot].z[tmpIdx0.rem] = other._meanDirections[tmpIdx1.quot].z[tmpIdx1.rem];
+
+        _distances[tmpIdx0.quot][tmpIdx0.rem] = other._distances[tmpIdx1.quot][tmpIdx1.rem];
+#ifdef OPENPGL_RADIANCE_CACHES
+        _fluenceRGBWeightsWithMIS[tmpIdx0.quot].x[tmpIdx0.rem] = other._fluenceRGBWeightsWithMIS[tmpIdx1.quot].x[tmpIdx1.rem] * otherFluenceWeight;
+        _fluenceRGBWeightsWithMIS[tmpIdx0.quot].y[tmpIdx0.rem] = other._fluenceRGBWeightsWithMIS[tmpIdx1.quot].y[tmpIdx1.rem] * otherFluenceWeight;
+        _fluenceRGBWeightsWithMIS[tmpIdx0.quot].z[tmpIdx0.rem] = other._fluenceRGBWeightsWithMIS[tmpIdx1.quot].z[tmpIdx1.rem] * otherFluenceWeight;
+
+        _fluenceRGBWeights[tmpIdx0.quot].x[tmpIdx0.rem] = other._fluenceRGBWeights[tmpIdx1.quot].x[tmpIdx1.rem] * otherFluenceWeight;
+        _fluenceRGBWeights[tmpIdx0.quot].y[tmpIdx0.rem] = other._fluenceRGBWeights[tmpIdx1.quot].y[tmpIdx1.rem] * otherFluenceWeight;
+        _fluenceRGBWeights[tmpIdx0.quot].z[tmpIdx0.rem] = other._fluenceRGBWeights[tmpIdx1.quot].z[tmpIdx1.rem] * otherFluenceWeight;
+#endif
+    }
+    _numComponents += other._numComponents;
+}
+
 template <int VecSize, int maxComponents, bool UseParallaxCompensation>
 void ParallaxAwareVonMisesFisherMixture<VecSize, maxComponents, UseParallaxCompensation>::swapComponents(const size_t &idx0, const size_t &idx1)
 {
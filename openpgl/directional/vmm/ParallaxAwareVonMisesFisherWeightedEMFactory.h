@@ -125,6 +125,9 @@ struct ParallaxAwareVonMisesFisherWeightedEMFactory
 
         void mergeComponentStats(const size_t &idx0, const size_t &idx1);
 
+        // appends the statistics of the components of another mixture (see VMM::appendComponents)
+        void appendComponentStats(const SufficientStatistics &stats);
+
         void splitComponentsStats(const size_t &idx0, const size_t &idx1, const Vector3 &meanDirection0, const Vector3 &meanDirection1, const float &meanCosine0,
                                   const float &meanCosine1);
 
@@ -468,6 +471,40 @@ void ParallaxAwareVonMisesFisherWeightedEMFactory<TVMMDistribution>::SufficientS
     std::swap(sumOfDistanceWeightes[tmpIdx0.quot][tmpIdx0.rem], sumOfDistanceWeightes[tmpIdx1.quot][tmpIdx1.rem]);
 }
 
+template <class TVMMDistribution>
+void ParallaxAwareVonMisesFisherWeightedEMFactory<TVMMDistribution>::SufficientStatistics::appendComponentStats(const SufficientStatistics &stats)
+{
+    OPENPGL_ASSERT(numComponents + stats.numComponents <= VMM::MaxComponents);
+
+    // the per component statistics of normalized statistics sum up to numSamples
+    // and otherwise to sumWeights
+    float scale = 1.f;
+    if (normalized && !stats.normalized && stats.sumWeights > 0.f)
+    {
+        scale = stats.numSamples / stats.sumWeights;
+    }
+    else if (!normalized && stats.normalized && stats.numSamples > 0.f)
+    {
+        scale = stats.sumWeights / stats.numSamples;
+    }
+
+    for (size_t i = 0; i < stats.numComponents; i++)
+    {
+        const div_t tmpIdx0 = div(numComponents + i, VMM::VectorSize);
+        const div_t tmpIdx1 = div(i, VMM::VectorSize);
+
+        sumOfWeightedDirections[tmpIdx0.quot].x[tmpIdx0.rem] = stats.sumOfWeightedDirections[tmpIdx1.quot].x[tmpIdx1.rem] * scale;
+        sumOfWeightedDirections[tmpIdx0.quot].y[tmpIdx0.rem] = stats.sumOfWeightedDirections[tmpIdx1.quot].y[tmpIdx1.rem] * scale;
+        sumOfWeightedDirections[tmpIdx0.quot].z[tmpIdx0.rem] = stats.sumOfWeightedDirections[tmpIdx1.quot].z[tmpIdx1.rem] * scale;
+        sumOfWeightedStats[tmpIdx0.quot][tmpIdx0.rem] = stats.sumOfWeightedStats[tmpIdx1.quot][tmpIdx1.rem] * scale;
+        sumOfDistanceWeightes[tmpIdx0.quot][tmpIdx0.rem] = stats.sumOfDistanceWeightes[tmpIdx1.quot][tmpIdx1.rem];
+    }
+    sumWeights += stats.sumWeights;
+    numSamples += stats.numSamples;
+    overallNumSamples += stats.overallNumSamples;
+    numComponents += stats.numComponents;
+}
+
 template <class TVMMDistribution>
 void ParallaxAwareVonMisesFisherWeightedEMFactory<TVMMDistribution>::SufficientStatistics::mergeComponentStats(const size_t &idx0, const size_t &idx1)
 {
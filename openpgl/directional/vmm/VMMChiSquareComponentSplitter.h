@@ -87,6 +87,9 @@ struct VonMisesFisherChiSquareComponentSplitter
         void mergeComponentStats(const size_t &idxI, const size_t &idxJ, const float &weightI, const Vector3 &meanDirectionI, const float &weightJ, const Vector3 &meanDirectionJ,
                                  const float &weightK, const Vector3 &meanDirectionK);
 
+        // appends the statistics of the components of another mixture (see VMM::appendComponents)
+        void appendComponentStats(const ComponentSplitStatistics &stats);
+
         Vector2 getSplitMean(const size_t &idx) const;
 
         Vector3 getSplitCovariance(const size_t &idx) const;
@@ -996,6 +999,32 @@ Vector3 VonMisesFisherChiSquareComponentSplitter<TVMMFactory>::ComponentSplitSta
     return covariance;
 }
 
+template <class TVMMFactory>
+void VonMisesFisherChiSquareComponentSplitter<TVMMFactory>::ComponentSplitStatistics::appendComponentStats(const ComponentSplitStatistics &stats)
+{
+    OPENPGL_ASSERT(numComponents + stats.numComponents <= VMM::MaxComponents);
+
+    for (size_t i = 0; i < stats.numComponents; i++)
+    {
+        const div_t tmpIdx0 = div(numComponents + i, VMM::VectorSize);
+        const div_t tmpIdx1 = div(i, VMM::VectorSize);
+
+        chiSquareMCEstimates[tmpIdx0.quot][tmpIdx0.rem] = stats.chiSquareMCEstimates[tmpIdx1.quot][tmpIdx1.rem];
+
+        splitMeans[tmpIdx0.quot].x[tmpIdx0.rem] = stats.splitMeans[tmpIdx1.quot].x[tmpIdx1.rem];
+        splitMeans[tmpIdx0.quot].y[tmpIdx0.rem] = stats.splitMeans[tmpIdx1.quot].y[tmpIdx1.rem];
+
+        splitWeightedSampleCovariances[tmpIdx0.quot].x[tmpIdx0.rem] = stats.splitWeightedSampleCovariances[tmpIdx1.quot].x[tmpIdx1.rem];
+        splitWeightedSampleCovariances[tmpIdx0.quot].y[tmpIdx0.rem] = stats.splitWeightedSampleCovariances[tmpIdx1.quot].y[tmpIdx1.rem];
+        splitWeightedSampleCovariances[tmpIdx0.quot].z[tmpIdx0.rem] = stats.splitWeightedSampleCovariances[tmpIdx1.quot].z[tmpIdx1.rem];
+
+        numSamples[tmpIdx0.quot][tmpIdx0.rem] = stats.numSamples[tmpIdx1.quot][tmpIdx1.rem];
+        sumWeights[tmpIdx0.quot][tmpIdx0.rem] = stats.sumWeights[tmpIdx1.quot][tmpIdx1.rem];
+        sumAssignedSamples[tmpIdx0.quot][tmpIdx0.rem] = stats.sumAssignedSamples[tmpIdx1.quot][tmpIdx1.rem];
+    }
+    numComponents += stats.numComponents;
+}
+
 template <class TVMMFactory>
 void VonMisesFisherChiSquareComponentSplitter<TVMMFactory>::ComponentSplitStatistics::mergeComponentStats(const size_t &idxI, const size_t &idxJ, const float &weightI,
                                                                                                           const Vector3 &meanDirectionI, const float &weightJ,
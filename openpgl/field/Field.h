@@ -13,10 +13,19 @@
 #ifdef USE_EMBREE_PARALLEL
 #define TASKING_TBB
 #include <embreeSrc/common/algorithms/parallel_for.h>
+#include <embreeSrc/common/algorithms/parallel_reduce.h>
 #else
 #include <tbb/parallel_for.h>
-#include <tbb/parallel_sort.h>
+#include <tbb/parallel_reduce.h>
 #endif
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
+
+#include <memory>
+#include <numeric>
 #define USE_PRECOMPUTED_NN 1
 
 namespace openpgl
@@ -34,6 +43,11 @@ struct Field
     using SampleContainerInternal = ContainerInternal<SampleData>;
     using ZeroValueSampleContainerInternal = ContainerInternal<ZeroValueSampleData>;
 
+    // number of children per node of the wide spatial structure (limited by the SIMD width of the device)
+    static const int WIDE_SPATIAL_STRUCTURE_WIDTH = Vecsize >= 8 ? 8 : 4;
+    // fraction of the memory budget (left by the samples) the regions are reduced to once the field exceeds the budget (see enforceMemoryBudget)
+    static constexpr float MEMORY_BUDGET_LOW_WATERMARK = 0.8f;
+
     typedef Region<DirectionalDistribution, typename TDirectionalDistributionFactory::Statistics> RegionType;
     typedef openpgl::Range RangeType;
     typedef std::pair<RegionType, RangeType> RegionStorageType;
@@ -46,6 +60,7 @@ struct Field
     struct DebugSettings
     {
         bool fitRegions{true};
+        bool profiling{false};
     };
 
     struct SpatialSettings
@@ -55,6 +70,18 @@ struct Field
         bool useISNNLookUp{false};
         bool deterministic{false};
         float decayOnSpatialSplit{0.25f};
+        float sceneBoundsTrimPercentile{0.f};
+        float sceneBoundsEnlargement{3.f};
+        size_t memoryBudget{0};
+        // the KD-tree based types only differ in the structure used for the look-ups
+        PGL_SPATIAL_STRUCTURE_TYPE spatialStructureType{PGL_SPATIAL_STRUCTURE_KDTREE};
+        // if each thread caches the path of its last spatial structure look-up (see KDTreeLookUpCache)
+        bool useLookUpCache{false};
+        // relative tolerance for the incremental update of the KNN neighbours (see KNearestRegionsSearchTree::updateRegionSearchTree)
+        float knnUpdateTolerance{0.f};
+        // the number of precomputed neighbours per region and of closest ones a KNN look-up selects from
+        size_t knnNumNeighbours{NUM_KNN_NEIGHBOURS};
+        size_t knnK{NUM_KNN};
 
         std::string toString() const;
     };
@@ -77,8 +104,17 @@ struct Field
         m_decayOnSpatialSplit = settings.settings.decayOnSpatialSplit;
         m_deterministic = settings.settings.deterministic;
         m_fitRegions = settings.debugSettings.fitRegions;
+        m_profiling = settings.debugSettings.profiling;
         m_useStochasticNNLookUp = settings.settings.useStochasticNNLookUp;
         m_useISNNLookUp = settings.settings.useISNNLookUp;
+        m_sceneBoundsTrimPercentile = settings.settings.sceneBoundsTrimPercentile;
+        m_sceneBoundsEnlargement = settings.settings.sceneBoundsEnlargement;
+        m_memoryBudget = settings.settings.memoryBudget;
+        m_spatialStructureType = settings.settings.spatialStructureType;
+        m_useLookUpCache = settings.settings.useLookUpCache;
+        resetLookUpCaches();
+        m_knnUpdateTolerance = settings.settings.knnUpdateTolerance;
+        m_regionKNNSearchTree.setNumNeighbours(uint32_t(settings.settings.knnNumNeighbours), uint32_t(settings.settings.knnK));
         m_spatialSubdivBuilderSettings = settings.settings.spatialSubdivBuilderSettings;
 
         m_distributionFactorySettings = settings.distributionFactorySettings;
@@ -106,6 +142,16 @@ struct Field
         m_isSurface = isSurface;
     }
 
+    void setSpatialStructureType(const PGL_SPATIAL_STRUCTURE_TYPE spatialStructureType)
+    {
+        m_spatialStructureType = spatialStructureType;
+    }
+
+    PGL_SPATIAL_STRUCTURE_TYPE getSpatialStructureType() const
+    {
+        return m_spatialStructureType;
+    }
+
     inline const RegionType *getRegion(const openpgl::Point3 &p, float *sample1D, uint32_t &id) const
     {
         if (m_iteration > 0 && embree::inside(m_spatialSubdiv.getBounds(), p))
@@ -132,7 +178,7 @@ struct Field
             }
             else
             {
-                uint32_t dataIdx = m_spatialSubdiv.getDataIdxAtPos(p);
+                uint32_t dataIdx = getDataIdxAtPos(p);
                 OPENPGL_ASSERT(dataIdx < m_regionStorageContainer.size());
                 id = dataIdx;
                 return &m_regionStorageContainer[dataIdx].first;
@@ -144,43 +190,212 @@ struct Field
         }
     }
 
+    // looks up the regions for multiple positions at once, the deterministic look-ups are
+    // done in packets of Vecsize positions using the SIMD traversal of the spatial structure
+    // while stochastic look-ups (sample1Ds[i] >= 0) fall back to getRegion
+    inline void getRegions(const size_t num, const openpgl::Point3 *positions, float *sample1Ds, const RegionType **regions, uint32_t *ids) const
+    {
+        using vfloat = embree::vfloat<Vecsize>;
+        using vint = embree::vint<Vecsize>;
+
+        const openpgl::BBox bounds = m_spatialSubdiv.getBounds();
+        for (size_t i = 0; i < num; i += Vecsize)
+        {
+            const size_t packetSize = std::min(size_t(Vecsize), num - i);
+            float x[Vecsize], y[Vecsize], z[Vecsize];
+            int valid[Vecsize];
+            bool anyValid = false;
+            for (size_t k = 0; k < Vecsize; k++)
+            {
+                x[k] = y[k] = z[k] = 0.f;
+                valid[k] = 0;
+                if (k >= packetSize)
+                {
+                    continue;
+                }
+                const size_t idx = i + k;
+                regions[idx] = nullptr;
+                ids[idx] = -1;
+                if (m_iteration == 0 || !embree::inside(bounds, positions[idx]))
+                {
+                    continue;
+                }
+                if (m_useStochasticNNLookUp && sample1Ds && sample1Ds[idx] >= 0.f)
+                {
+                    regions[idx] = getRegion(positions[idx], &sample1Ds[idx], ids[idx]);
+                    continue;
+                }
+                x[k] = positions[idx].x;
+                y[k] = positions[idx].y;
+                z[k] = positions[idx].z;
+                valid[k] = 1;
+                anyValid = true;
+            }
+
+            if (!anyValid)
+            {
+                continue;
+            }
+
+            const embree::Vec3<vfloat> pos(vfloat::loadu(x), vfloat::loadu(y), vfloat::loadu(z));
+            const vint dataIdxs = getDataIdxAtPos(pos, vint::loadu(valid) != vint(0));
+            for (size_t k = 0; k < packetSize; k++)
+            {
+                if (valid[k])
+                {
+                    const uint32_t dataIdx = dataIdxs[k];
+                    OPENPGL_ASSERT(dataIdx < m_regionStorageContainer.size());
+                    ids[i + k] = dataIdx;
+                    regions[i + k] = &m_regionStorageContainer[dataIdx].first;
+                }
+            }
+        }
+    }
+
     void buildField(const SampleContainer &samples)
+    {
+        copySamples(samples);
+        buildField();
+    }
+
+    void updateField(const SampleContainer &samples)
+    {
+        copySamples(samples);
+        updateField();
+    }
+
+    // copies the samples into the internal sample containers of the field
+    // which are used by the next call to buildField() or updateField()
+    void copySamples(const SampleContainer &samples)
+    {
+        Timer updateStep;
+        m_profilingStatistics.clear();
+        m_profilingStatistics.numThreads = getNumThreads();
+        ProfilingPhaseTimer phaseTimer(m_profilingStatistics.copySamples, getNumThreads(), m_profiling);
+        copyContainer(samples.samples, samples_);
+        copyContainer(samples.zeroValueSamples, zeroValueSamples_);
+        m_timeLastUpdateCopySamples = updateStep.elapsed() * 1e-3f;
+    }
+
+    size_t getNumSamples() const
+    {
+        return samples_.size();
+    }
+
+    // size in bytes of the regions, the spatial structure, the search structures of the
+    // regions and the samples of the current update
+    size_t getMemoryUsage() const
+    {
+        return getRegionsMemoryUsage() + samples_.size() * sizeof(SampleData) + zeroValueSamples_.size() * sizeof(ZeroValueSampleData);
+    }
+
+    // builds the field from the samples previously passed to copySamples()
+    void buildField()
     {
         m_iteration = 0;
         m_totalSPP = 0;
-        if (samples.samples.size() > 0)
+        buildFieldFromSamples();
+        m_iteration++;
+    }
+
+    // updates the field using the samples previously passed to copySamples()
+    void updateField()
+    {
+        updateFieldFromSamples();
+        m_iteration++;
+    }
+
+    // streaming update: the samples of one training iteration are passed in chunks, the samples of each
+    // chunk are partitioned into the spatial structure (i.e., the leaves are split and the sample statistics
+    // of the regions are updated) and accumulated, the directional distributions of the touched regions
+    // are updated once with all samples of the iteration by endSampleChunks()
+    // if the field was not trained before, the samples are only accumulated and the field is build
+    // (e.g., the scene bounds are estimated) from all samples by endSampleChunks()
+    void addSampleChunk(const SampleContainer &samples)
+    {
+        const size_t numThreads = getNumThreads();
+        if (!m_receivedSampleChunks)
         {
-            Timer updateAll;
-            Timer updateStep;
+            m_profilingStatistics.clear();
+            m_profilingStatistics.numThreads = numThreads;
+            m_timeLastUpdateCopySamples = 0.f;
+            m_timeLastUpdateSpatialStructureUpdate = 0.f;
+            m_touchedRegionIdxs.clear();
+            samples_.clear();
+            zeroValueSamples_.clear();
+            m_receivedSampleChunks = true;
+        }
 
-            if (samples_.capacity() < samples.samples.size())
+        Timer updateStep;
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.copySamples, numThreads, m_profiling);
+            copyContainer(samples.zeroValueSamples, zeroValueSamples_, zeroValueSamples_.size());
+            if (!m_initialized)
             {
-                samples_.reserve(2 * samples.samples.size());
+                copyContainer(samples.samples, samples_, samples_.size());
+                m_timeLastUpdateCopySamples += updateStep.elapsed() * 1e-3f;
+                return;
             }
-            samples_.resize(samples.samples.size());
-#ifdef USE_EMBREE_PARALLEL
-            embree::parallel_for(size_t(0), samples.samples.size(), size_t(4 * 4096), [&](const embree::range<size_t> &r) {
-#else
-            tbb::parallel_for(tbb::blocked_range<int>(0, samples.samples.size()), [&](tbb::blocked_range<int> r) {
-#endif
-                for (size_t i = r.begin(); i < r.end(); i++)
-                    samples_[i] = samples.samples[i];
-            });
+            copyContainer(samples.samples, m_sampleChunk);
+        }
+        m_timeLastUpdateCopySamples += updateStep.elapsed() * 1e-3f;
 
-            if (zeroValueSamples_.capacity() < samples.zeroValueSamples.size())
-            {
-                zeroValueSamples_.reserve(2 * samples.zeroValueSamples.size());
-            }
-            zeroValueSamples_.resize(samples.zeroValueSamples.size());
-#ifdef USE_EMBREE_PARALLEL
-            embree::parallel_for(size_t(0), samples.zeroValueSamples.size(), size_t(4 * 4096), [&](const embree::range<size_t> &r) {
-#else
-            tbb::parallel_for(tbb::blocked_range<int>(0, samples.zeroValueSamples.size()), [&](tbb::blocked_range<int> r) {
-#endif
-                for (size_t i = r.begin(); i < r.end(); i++)
-                    zeroValueSamples_[i] = samples.zeroValueSamples[i];
-            });
-            m_timeLastUpdateCopySamples = updateStep.elapsed() * 1e-3f;
+        updateStep.reset();
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.partitioning, numThreads, m_profiling);
+            m_spatialSubdivBuilder.updateTree(m_spatialSubdiv, m_sampleChunk, m_regionStorageContainer, m_spatialSubdivBuilderSettings, &m_touchedRegionIdxs);
+        }
+        m_timeLastUpdateSpatialStructureUpdate += updateStep.elapsed() * 1e-3f;
+
+        updateStep.reset();
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.copySamples, numThreads, m_profiling);
+            copyContainer(m_sampleChunk, samples_, samples_.size());
+        }
+        m_timeLastUpdateCopySamples += updateStep.elapsed() * 1e-3f;
+    }
+
+    // finishes a streaming update, the iteration only counts if the field received samples
+    void endSampleChunks()
+    {
+        if (!m_receivedSampleChunks)
+        {
+            return;
+        }
+        m_receivedSampleChunks = false;
+        m_sampleChunk.clear();
+
+        if (!m_initialized)
+        {
+            m_iteration = 0;
+            m_totalSPP = 0;
+            buildFieldFromSamples();
+        }
+        else if (samples_.size() > 0)
+        {
+            Timer updateAll;
+            Timer updateStep;
+
+            updateSpatialStructureFromSampleChunks(samples_, zeroValueSamples_);
+            m_timeLastUpdateSpatialStructureUpdate += updateStep.elapsed() * 1e-3f;
+
+            updateStep.reset();
+            updateRegions(samples_, zeroValueSamples_);
+
+            m_timeLastUpdateDirectionalDistriubtionUpdate = updateStep.elapsed() * 1e-3f;
+            enforceMemoryBudget();
+            m_timeLastUpdate = m_timeLastUpdateCopySamples + m_timeLastUpdateSpatialStructureUpdate + updateAll.elapsed() * 1e-3f;
+        }
+        m_iteration++;
+    }
+
+   private:
+    void buildFieldFromSamples()
+    {
+        if (samples_.size() > 0)
+        {
+            Timer updateAll;
+            Timer updateStep;
 
             if (!m_isSceneBoundsSet)
             {
@@ -193,48 +408,18 @@ struct Field
             updateStep.reset();
             fitRegions(samples_, zeroValueSamples_);
             m_timeLastUpdateDirectionalDistriubtionUpdate = updateStep.elapsed() * 1e-3f;
-            m_timeLastUpdate = updateAll.elapsed() * 1e-3f;
+            enforceMemoryBudget();
+            m_timeLastUpdate = m_timeLastUpdateCopySamples + updateAll.elapsed() * 1e-3f;
         }
-        m_iteration++;
     }
 
-    void updateField(const SampleContainer &samples)
+    void updateFieldFromSamples()
     {
-        if (samples.samples.size() > 0)
+        if (samples_.size() > 0)
         {
             Timer updateAll;
             Timer updateStep;
 
-            if (samples_.capacity() < samples.samples.size())
-            {
-                samples_.reserve(2 * samples.samples.size());
-            }
-            samples_.resize(samples.samples.size());
-#ifdef USE_EMBREE_PARALLEL
-            embree::parallel_for(size_t(0), samples.samples.size(), size_t(4 * 4096), [&](const embree::range<size_t> &r) {
-#else
-            tbb::parallel_for(tbb::blocked_range<int>(0, samples.samples.size()), [&](tbb::blocked_range<int> r) {
-#endif
-                for (size_t i = r.begin(); i < r.end(); i++)
-                    samples_[i] = samples.samples[i];
-            });
-
-            if (zeroValueSamples_.capacity() < samples.zeroValueSamples.size())
-            {
-                zeroValueSamples_.reserve(2 * samples.zeroValueSamples.size());
-            }
-            zeroValueSamples_.resize(samples.zeroValueSamples.size());
-#ifdef USE_EMBREE_PARALLEL
-            embree::parallel_for(size_t(0), samples.zeroValueSamples.size(), size_t(4 * 4096), [&](const embree::range<size_t> &r) {
-#else
-            tbb::parallel_for(tbb::blocked_range<int>(0, samples.zeroValueSamples.size()), [&](tbb::blocked_range<int> r) {
-#endif
-                for (size_t i = r.begin(); i < r.end(); i++)
-                    zeroValueSamples_[i] = samples.zeroValueSamples[i];
-            });
-            m_timeLastUpdateCopySamples = updateStep.elapsed() * 1e-3f;
-
-            updateStep.reset();
             updateSpatialStructure(samples_, zeroValueSamples_);
             m_timeLastUpdateSpatialStructureUpdate = updateStep.elapsed() * 1e-3f;
 
@@ -242,9 +427,52 @@ struct Field
             updateRegions(samples_, zeroValueSamples_);
 
             m_timeLastUpdateDirectionalDistriubtionUpdate = updateStep.elapsed() * 1e-3f;
-            m_timeLastUpdate = updateAll.elapsed() * 1e-3f;
+            enforceMemoryBudget();
+            m_timeLastUpdate = m_timeLastUpdateCopySamples + updateAll.elapsed() * 1e-3f;
         }
-        m_iteration++;
+    }
+
+   public:
+
+    // deep copies the state of another field (settings, spatial structure, regions and
+    // search structures) without its internal sample containers
+    void copyFrom(const Field &b)
+    {
+        m_isSurface = b.m_isSurface;
+        m_decayOnSpatialSplit = b.m_decayOnSpatialSplit;
+        m_iteration = b.m_iteration;
+        m_totalSPP = b.m_totalSPP;
+        m_fitRegions = b.m_fitRegions;
+        m_profiling = b.m_profiling;
+        m_deterministic = b.m_deterministic;
+        m_isSceneBoundsSet = b.m_isSceneBoundsSet;
+        m_sceneBounds = b.m_sceneBounds;
+        m_sceneBoundsTrimPercentile = b.m_sceneBoundsTrimPercentile;
+        m_sceneBoundsEnlargement = b.m_sceneBoundsEnlargement;
+        m_memoryBudget = b.m_memoryBudget;
+        m_spatialStructureType = b.m_spatialStructureType;
+        m_useLookUpCache = b.m_useLookUpCache;
+        m_initialized = b.m_initialized;
+
+        m_distributionFactorySettings = b.m_distributionFactorySettings;
+        m_spatialSubdivBuilderSettings = b.m_spatialSubdivBuilderSettings;
+        m_spatialSubdiv.copyFrom(b.m_spatialSubdiv);
+        resetLookUpCaches();
+        m_regionStorageContainer = b.m_regionStorageContainer;
+
+        m_useStochasticNNLookUp = b.m_useStochasticNNLookUp;
+        m_useISNNLookUp = b.m_useISNNLookUp;
+        m_knnUpdateTolerance = b.m_knnUpdateTolerance;
+        m_regionKNNSearchTree.copyFrom(b.m_regionKNNSearchTree);
+
+        m_timeLastUpdate = b.m_timeLastUpdate;
+        m_timeLastUpdateCopySamples = b.m_timeLastUpdateCopySamples;
+        m_timeLastUpdateSpatialStructureUpdate = b.m_timeLastUpdateSpatialStructureUpdate;
+        m_timeLastUpdateDirectionalDistriubtionUpdate = b.m_timeLastUpdateDirectionalDistriubtionUpdate;
+        m_numLastUpdateRegions = b.m_numLastUpdateRegions;
+        m_timeLastUpdateRegionFitMax = b.m_timeLastUpdateRegionFitMax;
+        m_timeLastUpdateRegionFitTotal = b.m_timeLastUpdateRegionFitTotal;
+        m_profilingStatistics = b.m_profilingStatistics;
     }
 
     void resetField()
@@ -256,6 +484,7 @@ struct Field
         m_initialized = false;
 
         m_spatialSubdiv = SpatialStructure();
+        resetLookUpCaches();
         m_regionStorageContainer.clear();
         m_regionKNNSearchTree.reset();
     }
@@ -317,6 +546,10 @@ struct Field
         m_distributionFactorySettings.deserialize(is);
         m_spatialSubdivBuilderSettings.deserialize(is);
         m_spatialSubdiv.deserialize(is);
+        if (m_spatialSubdiv.getNumNodes() > 0)
+        {
+            buildSpatialLookUpStructure();
+        }
         size_t size;
         is.read(reinterpret_cast<char *>(&size), sizeof(size));
         m_regionStorageContainer.clear();
@@ -331,7 +564,8 @@ struct Field
         is.read(reinterpret_cast<char *>(&m_useISNNLookUp), sizeof(m_useISNNLookUp));
         m_regionKNNSearchTree.deserialize(is);
 
-        if (m_useStochasticNNLookUp && USE_PRECOMPUTED_NN && m_regionKNNSearchTree.isBuild())
+        // the neighbours are only recomputed if they were not stored
+        if (m_useStochasticNNLookUp && USE_PRECOMPUTED_NN && m_regionKNNSearchTree.isBuild() && !m_regionKNNSearchTree.isBuildNeighbours())
         {
             m_regionKNNSearchTree.buildRegionNeighbours();
         }
@@ -354,27 +588,199 @@ struct Field
         return m_initialized;
     }
 
+    bool isProfilingEnabled() const
+    {
+        return m_profiling;
+    }
+
    private:
     void estimateSceneBounds(const SampleContainerInternal &samples)
     {
-        m_sceneBounds.lower = Vector3(std::numeric_limits<float>::max());
-        m_sceneBounds.upper = Vector3(std::numeric_limits<float>::min());
+        m_sceneBounds = BBox(embree::empty);
         m_isSceneBoundsSet = false;
 
         if (samples.size() > 0)
         {
-            // TODO parallize this part (also use some stats?)
-            for (const auto &sample : samples)
+            m_sceneBounds = computeSampleBounds(samples);
+            if (m_sceneBoundsTrimPercentile > 0.f)
             {
-                m_sceneBounds.extend(Vector3(sample.position.x, sample.position.y, sample.position.z));
+                m_sceneBounds = trimSampleBounds(samples, m_sceneBounds, m_sceneBoundsTrimPercentile);
             }
             Vector3 center = m_sceneBounds.center();
-            m_sceneBounds.lower = center + 3.0f * (m_sceneBounds.lower - center);
-            m_sceneBounds.upper = center + 3.0f * (m_sceneBounds.upper - center);
+            m_sceneBounds.lower = center + m_sceneBoundsEnlargement * (m_sceneBounds.lower - center);
+            m_sceneBounds.upper = center + m_sceneBoundsEnlargement * (m_sceneBounds.upper - center);
             m_isSceneBoundsSet = true;
         }
     }
 
+    static BBox computeSampleBounds(const SampleContainerInternal &samples)
+    {
+        const SampleData *sampleData = samples.data();
+        auto extendBounds = [sampleData](const size_t begin, const size_t end, BBox bounds) -> BBox {
+            for (size_t i = begin; i < end; i++)
+            {
+                bounds.extend(Vector3(sampleData[i].position.x, sampleData[i].position.y, sampleData[i].position.z));
+            }
+            return bounds;
+        };
+#ifdef USE_EMBREE_PARALLEL
+        return embree::parallel_reduce(
+            size_t(0), samples.size(), size_t(4 * 4096), BBox(embree::empty),
+            [&](const embree::range<size_t> &r) -> BBox {
+                return extendBounds(r.begin(), r.end(), BBox(embree::empty));
+            },
+            [](const BBox &a, const BBox &b) {
+                return embree::merge(a, b);
+            });
+#else
+        return tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, samples.size(), 4 * 4096), BBox(embree::empty),
+            [&](const tbb::blocked_range<size_t> &r, BBox bounds) -> BBox {
+                return extendBounds(r.begin(), r.end(), bounds);
+            },
+            [](const BBox &a, const BBox &b) {
+                return embree::merge(a, b);
+            });
+#endif
+    }
+
+    // per dimension histogram of the sample positions inside given bounds
+    struct SampleBoundsHistogram
+    {
+        static const int NUM_BINS = 256;
+        uint32_t counts[3][NUM_BINS];
+
+        SampleBoundsHistogram()
+        {
+            std::fill(&counts[0][0], &counts[0][0] + 3 * NUM_BINS, 0);
+        }
+
+        static SampleBoundsHistogram merge(const SampleBoundsHistogram &a, const SampleBoundsHistogram &b)
+        {
+            SampleBoundsHistogram c;
+            for (int d = 0; d < 3; d++)
+                for (int i = 0; i < NUM_BINS; i++)
+                    c.counts[d][i] = a.counts[d][i] + b.counts[d][i];
+            return c;
+        }
+    };
+
+    // shrinks the bounds of the samples to the [percentile, 1 - percentile] range of the
+    // sample positions in each dimension, the percentiles are estimated using a histogram
+    static BBox trimSampleBounds(const SampleContainerInternal &samples, const BBox &bounds, const float percentile)
+    {
+        const int numBins = SampleBoundsHistogram::NUM_BINS;
+        const Vector3 extent = bounds.size();
+        const Vector3 binSize = extent / float(numBins);
+        const SampleData *sampleData = samples.data();
+        auto fillHistogram = [&](const size_t begin, const size_t end, SampleBoundsHistogram &histogram) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const Vector3 p(sampleData[i].position.x, sampleData[i].position.y, sampleData[i].position.z);
+                for (int d = 0; d < 3; d++)
+                {
+                    const int bin = extent[d] > 0.f ? std::min(int((p[d] - bounds.lower[d]) / binSize[d]), numBins - 1) : 0;
+                    histogram.counts[d][std::max(bin, 0)]++;
+                }
+            }
+        };
+#ifdef USE_EMBREE_PARALLEL
+        const SampleBoundsHistogram histogram = embree::parallel_reduce(
+            size_t(0), samples.size(), size_t(4 * 4096), SampleBoundsHistogram(),
+            [&](const embree::range<size_t> &r) -> SampleBoundsHistogram {
+                SampleBoundsHistogram histogram;
+                fillHistogram(r.begin(), r.end(), histogram);
+                return histogram;
+            },
+            [](const SampleBoundsHistogram &a, const SampleBoundsHistogram &b) {
+                return SampleBoundsHistogram::merge(a, b);
+            });
+#else
+        const SampleBoundsHistogram histogram = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, samples.size(), 4 * 4096), SampleBoundsHistogram(),
+            [&](const tbb::blocked_range<size_t> &r, SampleBoundsHistogram histogram) -> SampleBoundsHistogram {
+                fillHistogram(r.begin(), r.end(), histogram);
+                return histogram;
+            },
+            [](const SampleBoundsHistogram &a, const SampleBoundsHistogram &b) {
+                return SampleBoundsHistogram::merge(a, b);
+            });
+#endif
+        const size_t numTrimmed = size_t(std::min(percentile, 0.49f) * float(samples.size()));
+        BBox trimmedBounds = bounds;
+        for (int d = 0; d < 3; d++)
+        {
+            size_t count = 0;
+            int lowerBin = 0;
+            while (lowerBin < numBins - 1 && count + histogram.counts[d][lowerBin] <= numTrimmed)
+            {
+                count += histogram.counts[d][lowerBin++];
+            }
+            count = 0;
+            int upperBin = numBins - 1;
+            while (upperBin > lowerBin && count + histogram.counts[d][upperBin] <= numTrimmed)
+            {
+                count += histogram.counts[d][upperBin--];
+            }
+            trimmedBounds.lower[d] = bounds.lower[d] + float(lowerBin) * binSize[d];
+            trimmedBounds.upper[d] = bounds.lower[d] + float(upperBin + 1) * binSize[d];
+        }
+        return trimmedBounds;
+    }
+
+    // copies a concurrent_vector into a contiguous internal container. The elements of a
+    // concurrent_vector are stored in segments of power-of-two size, which are contiguous in memory.
+    // Instead of accessing each element through the segment table, the data of each segment
+    // is copied as one block.
+    // if offset is given the elements are appended to the first offset elements of dst
+    template <typename TConcurrentContainer, typename TContainerInternal>
+    static void copyContainer(const TConcurrentContainer &src, TContainerInternal &dst, const size_t offset = 0)
+    {
+        using ValueType = typename TContainerInternal::value_type;
+        const size_t size = src.size();
+        if (dst.capacity() < offset + size)
+        {
+            dst.reserve(2 * (offset + size));
+        }
+        dst.resize(offset + size);
+        if (size == 0)
+        {
+            return;
+        }
+
+        ValueType *dstData = dst.data() + offset;
+#ifdef USE_EMBREE_PARALLEL
+        embree::parallel_for(size_t(0), size, size_t(4 * 4096), [&](const embree::range<size_t> &r) {
+#else
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, size, 4 * 4096), [&](tbb::blocked_range<size_t> r) {
+#endif
+            size_t i = r.begin();
+            while (i < r.end())
+            {
+                // the first segment holds two elements, each following segment k
+                // holds the elements [2^k, 2^(k+1))
+                size_t segmentEnd = 2;
+                while (segmentEnd <= i)
+                {
+                    segmentEnd <<= 1;
+                }
+                const size_t end = std::min(segmentEnd, r.end());
+                const ValueType *first = &src[i];
+                const ValueType *last = &src[end - 1];
+                if (size_t(last - first) == end - 1 - i)
+                {
+                    std::copy(first, last + 1, dstData + i);
+                }
+                else
+                {
+                    for (size_t j = i; j < end; j++)
+                        dstData[j] = src[j];
+                }
+                i = end;
+            }
+        });
+    }
+
     inline uint32_t getClosestRegionIdx(const KNearestRegionsSearchTree<Vecsize> &knnTree, const openpgl::Point3 &p, float *sample, uint32_t &id) const
     {
         OPENPGL_ASSERT(knnTree.isBuild());
@@ -382,10 +788,77 @@ struct Field
         return regionIdx;
     }
 
+    inline uint32_t getDataIdxAtPos(const openpgl::Point3 &p) const
+    {
+        if (m_useLookUpCache)
+        {
+            return m_spatialSubdiv.getDataIdxAtPos(p, m_lookUpCaches->local());
+        }
+        switch (m_spatialStructureType)
+        {
+            case PGL_SPATIAL_STRUCTURE_KDTREE_WIDE:
+                return m_spatialSubdiv.template getDataIdxAtPosWide<WIDE_SPATIAL_STRUCTURE_WIDTH>(p);
+            case PGL_SPATIAL_STRUCTURE_KDTREE_GRID:
+                return m_spatialSubdiv.getDataIdxAtPosGrid(p);
+            default:
+                return m_spatialSubdiv.getDataIdxAtPos(p);
+        }
+    }
+
+    inline embree::vint<Vecsize> getDataIdxAtPos(const embree::Vec3<embree::vfloat<Vecsize>> &pos, const embree::vbool<Vecsize> &valid) const
+    {
+        if (m_spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_GRID)
+        {
+            return m_spatialSubdiv.template getDataIdxAtPosGrid<Vecsize>(pos, valid);
+        }
+        return m_spatialSubdiv.template getDataIdxAtPos<Vecsize>(pos, valid);
+    }
+
+    // invalidates the look-up caches of all threads, the caches are only allocated if they are enabled
+    void resetLookUpCaches()
+    {
+        if (!m_useLookUpCache)
+        {
+            m_lookUpCaches.reset();
+        }
+        else if (!m_lookUpCaches)
+        {
+            m_lookUpCaches.reset(new LookUpCaches());
+        }
+        else
+        {
+            m_lookUpCaches->clear();
+        }
+    }
+
+    // builds the additional look-up structure of the wide and the grid type (if used)
+    // and invalidates the look-up caches of all threads. The look-up caches replace the
+    // traversal of the single look-ups, so that the wide nodes are not build if they are
+    // enabled. The grid is still build, since it is used by the batched look-ups.
+    void buildSpatialLookUpStructure()
+    {
+        resetLookUpCaches();
+        if (m_spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_WIDE && !m_useLookUpCache)
+        {
+            m_spatialSubdiv.template buildWideNodes<WIDE_SPATIAL_STRUCTURE_WIDTH>();
+        }
+        else if (m_spatialStructureType == PGL_SPATIAL_STRUCTURE_KDTREE_GRID)
+        {
+            m_spatialSubdiv.buildLookUpGrid();
+        }
+    }
+
+    // prepares the spatial structure for querying after it was build or updated
+    void finalizeSpatialStructure()
+    {
+        m_spatialSubdiv.finalize();
+        buildSpatialLookUpStructure();
+    }
+
     inline uint32_t getApproximateClosestRegionIdx(const KNearestRegionsSearchTree<Vecsize> &knnTree, const openpgl::Point3 &p, float *sample, uint32_t &id) const
     {
         OPENPGL_ASSERT(knnTree.isBuildNeighbours());
-        uint32_t dataIdx = m_spatialSubdiv.getDataIdxAtPos(p);
+        uint32_t dataIdx = getDataIdxAtPos(p);
         OPENPGL_ASSERT(dataIdx < m_regionStorageContainer.size());
         id = dataIdx;
         if (m_useISNNLookUp)
@@ -396,12 +869,40 @@ struct Field
 
     inline void buildSpatialStructure(const BBox &bounds, SampleContainerInternal &samples)
     {
-        m_spatialSubdivBuilder.build(m_spatialSubdiv, bounds, samples, m_regionStorageContainer, m_spatialSubdivBuilderSettings);
+        const size_t numThreads = getNumThreads();
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.partitioning, numThreads, m_profiling);
+            m_spatialSubdivBuilder.build(m_spatialSubdiv, bounds, samples, m_regionStorageContainer, m_spatialSubdivBuilderSettings);
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.treeletRebuild, numThreads, m_profiling);
+            finalizeSpatialStructure();
+        }
+        buildRegionSearchStructures();
+    }
+
+    // rebuilds the KNN search structures of the regions, if incremental is true and the neighbours are
+    // already precomputed only the neighbours of the regions which changed since the last build are
+    // updated (requires that the indices of the existing regions did not change)
+    inline void buildRegionSearchStructures(const bool incremental = false)
+    {
         if (m_useStochasticNNLookUp)
         {
-            m_regionKNNSearchTree.buildRegionSearchTree(m_regionStorageContainer);
+            const size_t numThreads = getNumThreads();
+            if (incremental && USE_PRECOMPUTED_NN && m_regionKNNSearchTree.isBuildNeighbours())
+            {
+                ProfilingPhaseTimer phaseTimer(m_profilingStatistics.neighbourBuild, numThreads, m_profiling);
+                m_regionKNNSearchTree.updateRegionSearchTree(m_regionStorageContainer, m_knnUpdateTolerance);
+                return;
+            }
+            {
+                ProfilingPhaseTimer phaseTimer(m_profilingStatistics.knnBuild, numThreads, m_profiling);
+                m_regionKNNSearchTree.reset();
+                m_regionKNNSearchTree.buildRegionSearchTree(m_regionStorageContainer);
+            }
             if (USE_PRECOMPUTED_NN)
             {
+                ProfilingPhaseTimer phaseTimer(m_profilingStatistics.neighbourBuild, numThreads, m_profiling);
                 m_regionKNNSearchTree.buildRegionNeighbours();
             }
         }
@@ -409,46 +910,202 @@ struct Field
 
     inline void updateSpatialStructure(SampleContainerInternal &samples, ZeroValueSampleContainerInternal &zeroValueSamples)
     {
-        m_spatialSubdivBuilder.updateTree(m_spatialSubdiv, samples, m_regionStorageContainer, m_spatialSubdivBuilderSettings);
-        m_spatialSubdivBuilder.insertTree(m_spatialSubdiv, zeroValueSamples, m_regionStorageContainer);
-        if (m_useStochasticNNLookUp)
+        const size_t numThreads = getNumThreads();
+        m_touchedRegionIdxs.clear();
         {
-            m_regionKNNSearchTree.reset();
-            m_regionKNNSearchTree.buildRegionSearchTree(m_regionStorageContainer);
-            if (USE_PRECOMPUTED_NN)
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.partitioning, numThreads, m_profiling);
+            m_spatialSubdivBuilder.updateTree(m_spatialSubdiv, samples, m_regionStorageContainer, m_spatialSubdivBuilderSettings, &m_touchedRegionIdxs);
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.zeroValueInsertion, numThreads, m_profiling);
+            m_spatialSubdivBuilder.insertTree(m_spatialSubdiv, zeroValueSamples, m_regionStorageContainer, &m_touchedRegionIdxs);
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.treeletRebuild, numThreads, m_profiling);
+            finalizeSpatialStructure();
+        }
+
+        // a region can be touched by the samples and the zero-value samples
+        m_updateRegionIdxs.assign(m_touchedRegionIdxs.begin(), m_touchedRegionIdxs.end());
+        std::sort(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end());
+        m_updateRegionIdxs.erase(std::unique(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end()), m_updateRegionIdxs.end());
+        buildRegionSearchStructures(true);
+    }
+
+    // finishes the spatial structure update of a streaming update, the leaves were already split and the sample
+    // statistics of the regions updated by the chunks (see addSampleChunk), the accumulated samples only need to
+    // be assigned to the regions
+    inline void updateSpatialStructureFromSampleChunks(SampleContainerInternal &samples, ZeroValueSampleContainerInternal &zeroValueSamples)
+    {
+        const size_t numThreads = getNumThreads();
+        // the sample ranges of the regions refer to the chunks they were touched by
+        for (const uint32_t idx : m_touchedRegionIdxs)
+        {
+            m_regionStorageContainer[idx].second = Range();
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.partitioning, numThreads, m_profiling);
+            m_spatialSubdivBuilder.partitionTree(m_spatialSubdiv, samples, m_regionStorageContainer, &m_touchedRegionIdxs);
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.zeroValueInsertion, numThreads, m_profiling);
+            m_spatialSubdivBuilder.insertTree(m_spatialSubdiv, zeroValueSamples, m_regionStorageContainer, &m_touchedRegionIdxs);
+        }
+        {
+            ProfilingPhaseTimer phaseTimer(m_profilingStatistics.treeletRebuild, numThreads, m_profiling);
+            finalizeSpatialStructure();
+        }
+
+        m_updateRegionIdxs.assign(m_touchedRegionIdxs.begin(), m_touchedRegionIdxs.end());
+        std::sort(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end());
+        m_updateRegionIdxs.erase(std::unique(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end()), m_updateRegionIdxs.end());
+        buildRegionSearchStructures(true);
+    }
+
+    // size in bytes of the regions, the spatial structure and the search structures of the regions,
+    // i.e., the memory which depends on the number of regions
+    size_t getRegionsMemoryUsage() const
+    {
+        return m_regionStorageContainer.size() * sizeof(RegionStorageType) + m_spatialSubdiv.getMemoryUsage() + m_regionKNNSearchTree.getMemoryUsage();
+    }
+
+    // merges the regions which received the fewest samples with their siblings if the field exceeds the
+    // memory budget, the regions are merged until they only occupy MEMORY_BUDGET_LOW_WATERMARK of the budget
+    // left by the samples so that the following updates can split regions again without exceeding the budget
+    // (since the regions with the fewest samples are merged first they are also the least likely to be split again)
+    void enforceMemoryBudget()
+    {
+        const size_t numRegions = m_regionStorageContainer.size();
+        if (m_memoryBudget == 0 || numRegions == 0)
+        {
+            return;
+        }
+        const size_t memoryUsage = getMemoryUsage();
+        if (memoryUsage <= m_memoryBudget)
+        {
+            return;
+        }
+        // the memory of the samples does not depend on the number of regions
+        const size_t regionsMemoryUsage = getRegionsMemoryUsage();
+        const size_t fixedMemoryUsage = memoryUsage - regionsMemoryUsage;
+        const size_t sizePerRegion = std::max(size_t(1), regionsMemoryUsage / numRegions);
+        const size_t regionsMemoryBudget = m_memoryBudget > fixedMemoryUsage ? size_t(MEMORY_BUDGET_LOW_WATERMARK * float(m_memoryBudget - fixedMemoryUsage)) : 0;
+        const size_t maxNumRegions = std::max(size_t(1), regionsMemoryBudget / sizePerRegion);
+
+        auto mergeRegions = [&](RegionType &region, RegionType &otherRegion) {
+            // TODO: we should move applying the paralax comp to the Distribution to the factory
+            if (DirectionalDistribution::ParallaxCompensation == 1)
             {
-                m_regionKNNSearchTree.buildRegionNeighbours();
+                // both distributions are moved to the pivot of the merged region (i.e., the mean of all samples)
+                SampleStatistics sampleStatistics = region.sampleStatistics;
+                sampleStatistics.merge(otherRegion.sampleStatistics);
+                const openpgl::Point3 sampleMean = sampleStatistics.mean;
+                region.trainingStatistics.sufficientStatistics.applyParallaxShift(region.distribution, region.distribution._pivotPosition - sampleMean);
+                region.distribution.performRelativeParallaxShift(region.distribution._pivotPosition - sampleMean);
+                otherRegion.trainingStatistics.sufficientStatistics.applyParallaxShift(otherRegion.distribution, otherRegion.distribution._pivotPosition - sampleMean);
+                otherRegion.distribution.performRelativeParallaxShift(otherRegion.distribution._pivotPosition - sampleMean);
             }
+            m_distributionFactory.merge(region.distribution, region.trainingStatistics, otherRegion.distribution, otherRegion.trainingStatistics,
+                                        m_distributionFactorySettings);
+        };
+        if (m_spatialSubdivBuilder.coarsenTree(m_spatialSubdiv, m_regionStorageContainer, maxNumRegions, mergeRegions))
+        {
+            finalizeSpatialStructure();
+            buildRegionSearchStructures();
         }
     }
 
+    // sorts the regions which need an update by their estimated fitting costs (number of samples
+    // times the number of components of the distribution), so that the most expensive regions are
+    // processed first and the cheap ones can be used to balance the load at the end
+    void sortUpdateRegionsByCosts()
+    {
+        auto estimateCosts = [&](const uint32_t idx) -> size_t {
+            const RegionStorageType &regionStorage = m_regionStorageContainer[idx];
+            return regionStorage.second.size() * std::max(size_t(1), size_t(regionStorage.first.distribution.getNumComponents()));
+        };
+        m_updateRegionCosts.resize(m_regionStorageContainer.size());
+        for (const uint32_t idx : m_updateRegionIdxs)
+        {
+            m_updateRegionCosts[idx] = estimateCosts(idx);
+        }
+        tbb::parallel_sort(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end(), [&](const uint32_t a, const uint32_t b) {
+            return m_updateRegionCosts[a] > m_updateRegionCosts[b] || (m_updateRegionCosts[a] == m_updateRegionCosts[b] && a < b);
+        });
+        m_regionFitTimes.resize(m_updateRegionIdxs.size());
+        m_regionFittingStatistics.assign(m_updateRegionIdxs.size(), typename DirectionalDistributionFactory::FittingStatistics());
+    }
+
+    // accumulates the per-region fitting times of the last update
+    void updateRegionFitTimeStatistics()
+    {
+        m_timeLastUpdateRegionFitMax = 0.f;
+        m_timeLastUpdateRegionFitTotal = 0.f;
+        for (const float time : m_regionFitTimes)
+        {
+            m_timeLastUpdateRegionFitMax = std::max(m_timeLastUpdateRegionFitMax, time);
+            m_timeLastUpdateRegionFitTotal += time;
+        }
+        m_numLastUpdateRegions = m_regionFitTimes.size();
+
+        if (m_profiling)
+        {
+            for (size_t i = 0; i < m_regionFittingStatistics.size(); i++)
+            {
+                const typename DirectionalDistributionFactory::FittingStatistics &fittingStats = m_regionFittingStatistics[i];
+                m_profilingStatistics.timeEM += fittingStats.timeEM;
+                m_profilingStatistics.timeSplit += fittingStats.timeSplit;
+                m_profilingStatistics.timeMerge += fittingStats.timeMerge;
+                m_profilingStatistics.timeDistanceUpdate += fittingStats.timeDistanceUpdate;
+                m_profilingStatistics.regionFitTimeHistogram.addValue(m_regionFitTimes[i] * 1e3f);
+                m_profilingStatistics.emIterationsHistogram.addValue(float(fittingStats.numUpdateWEMIterations + fittingStats.numPartialUpdateWEMIterations));
+                m_profilingStatistics.numSamplesHistogram.addValue(float(fittingStats.numSamples));
+            }
+        }
+    }
+
+    static size_t getNumThreads()
+    {
+        return size_t(tbb::this_task_arena::max_concurrency());
+    }
+
     inline void fitRegions(SampleContainerInternal &samples, ZeroValueSampleContainerInternal &zeroValueSamples)
     {
         size_t nGuidingRegions = m_regionStorageContainer.size();
 #if defined(OPENPGL_SHOW_PRINT_OUTS)
         std::cout << "fitRegion: " << (m_isSurface ? "surface" : "volume") << "\tnGuidingRegions = " << nGuidingRegions << std::endl;
 #endif
-
+        // all regions are new and have to be fitted
+        m_updateRegionIdxs.resize(nGuidingRegions);
+        std::iota(m_updateRegionIdxs.begin(), m_updateRegionIdxs.end(), 0);
+        sortUpdateRegionsByCosts();
+        ProfilingPhaseTimer phaseTimer(m_profilingStatistics.regionFitting, getNumThreads(), m_profiling);
+        // the scratch memory of the deterministic sorting only lives for this update
+        tbb::enumerable_thread_specific<RadixSortSampleDataBuffer> sortBuffers;
+
+        // the regions are sorted by their costs, the simple_partitioner
+        // avoids that the expensive regions are grouped into the same task
 #ifdef USE_EMBREE_PARALLEL
-        embree::parallel_for(0, (int)nGuidingRegions, 1, [&](const embree::range<unsigned> &r) {
-            for (size_t n = r.begin(); n < r.end(); n++)
+        embree::parallel_for_static(nGuidingRegions, [&](const size_t i)
 #else
-        tbb::parallel_for(tbb::blocked_range<int>(0, nGuidingRegions), [&](tbb::blocked_range<int> r) {
-            for (int n = r.begin(); n < r.end(); ++n)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, nGuidingRegions, 1), [&](tbb::blocked_range<size_t> r) {
+            for (size_t i = r.begin(); i < r.end(); ++i)
 #endif
             {
+                Timer regionTimer;
+                const uint32_t n = m_updateRegionIdxs[i];
                 RegionStorageType &regionStorage = m_regionStorageContainer[n];
                 openpgl::Point3 sampleMean = regionStorage.first.sampleStatistics.mean;
                 if (regionStorage.second.size() > 0)
                 {
                     if (m_deterministic)
                     {
-                        std::sort(samples.begin() + regionStorage.second.m_begin, samples.begin() + regionStorage.second.m_end, SampleDataLess);
+                        RadixSortSampleData(samples.data() + regionStorage.second.m_begin, regionStorage.second.m_end - regionStorage.second.m_begin, sortBuffers.local());
                     }
 
                     if (m_fitRegions)
                     {
-                        typename DirectionalDistributionFactory::FittingStatistics fittingStats;
+                        typename DirectionalDistributionFactory::FittingStatistics &fittingStats = m_regionFittingStatistics[i];
                         m_distributionFactory.prepareSamples(samples.data() + regionStorage.second.m_begin, regionStorage.second.m_end - regionStorage.second.m_begin,
                                                              regionStorage.first.sampleStatistics, m_distributionFactorySettings);
                         m_distributionFactory.fit(regionStorage.first.distribution, regionStorage.first.trainingStatistics, samples.data() + regionStorage.second.m_begin,
@@ -479,26 +1136,43 @@ struct Field
                 }
                 regionStorage.second.reset();
                 OPENPGL_ASSERT(regionStorage.first.isValid());
+                m_regionFitTimes[i] = regionTimer.elapsed() * 1e-3f;
             }
-        });
+#ifdef USE_EMBREE_PARALLEL
+        );
+#else
+        }, tbb::simple_partitioner());
+#endif
+        updateRegionFitTimeStatistics();
         m_initialized = true;
         OPENPGL_ASSERT(this->isValid());
     }
 
+    // only the regions touched during the last spatial structure update (see m_updateRegionIdxs)
+    // are updated, all other regions did not receive any samples and were not split
     void updateRegions(SampleContainerInternal &samples, ZeroValueSampleContainerInternal &zeroValueSamples)
     {
-        size_t nGuidingRegions = m_regionStorageContainer.size();
+        size_t nUpdateRegions = m_updateRegionIdxs.size();
 #if defined(OPENPGL_SHOW_PRINT_OUTS)
-        std::cout << "updateRegion: " << (m_isSurface ? "surface" : "volume") << "\tnGuidingRegions = " << nGuidingRegions << std::endl;
+        std::cout << "updateRegion: " << (m_isSurface ? "surface" : "volume") << "\tnGuidingRegions = " << m_regionStorageContainer.size()
+                  << "\tnUpdateRegions = " << nUpdateRegions << std::endl;
 #endif
+        sortUpdateRegionsByCosts();
+        ProfilingPhaseTimer phaseTimer(m_profilingStatistics.regionFitting, getNumThreads(), m_profiling);
+        // the scratch memory of the deterministic sorting only lives for this update
+        tbb::enumerable_thread_specific<RadixSortSampleDataBuffer> sortBuffers;
+
+        // the regions are sorted by their costs, the simple_partitioner
+        // avoids that the expensive regions are grouped into the same task
 #ifdef USE_EMBREE_PARALLEL
-        embree::parallel_for(0, (int)nGuidingRegions, 1, [&](const embree::range<unsigned> &r) {
-            for (size_t n = r.begin(); n < r.end(); n++)
+        embree::parallel_for_static(nUpdateRegions, [&](const size_t i)
 #else
-        tbb::parallel_for(tbb::blocked_range<int>(0, nGuidingRegions), [&](tbb::blocked_range<int> r) {
-            for (int n = r.begin(); n < r.end(); ++n)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, nUpdateRegions, 1), [&](tbb::blocked_range<size_t> r) {
+            for (size_t i = r.begin(); i < r.end(); ++i)
 #endif
             {
+                Timer regionTimer;
+                const uint32_t n = m_updateRegionIdxs[i];
                 RegionStorageType &regionStorage = m_regionStorageContainer[n];
                 if (regionStorage.first.splitFlag)
                 {
@@ -518,7 +1192,7 @@ struct Field
 #endif
                     if (m_deterministic)
                     {
-                        std::sort(samples.begin() + regionStorage.second.m_begin, samples.begin() + regionStorage.second.m_end, SampleDataLess);
+                        RadixSortSampleData(samples.data() + regionStorage.second.m_begin, regionStorage.second.m_end - regionStorage.second.m_begin, sortBuffers.local());
                     }
 
                     if (m_fitRegions)
@@ -532,7 +1206,7 @@ struct Field
                             OPENPGL_ASSERT(regionStorage.first.distribution.isValid());
                             OPENPGL_ASSERT(regionStorage.first.trainingStatistics.sufficientStatistics.isValid());
                         }
-                        typename DirectionalDistributionFactory::FittingStatistics fittingStats;
+                        typename DirectionalDistributionFactory::FittingStatistics &fittingStats = m_regionFittingStatistics[i];
                         m_distributionFactory.prepareSamples(samples.data() + regionStorage.second.m_begin, regionStorage.second.m_end - regionStorage.second.m_begin,
                                                              regionStorage.first.sampleStatistics, m_distributionFactorySettings);
                         m_distributionFactory.update(regionStorage.first.distribution, regionStorage.first.trainingStatistics, samples.data() + regionStorage.second.m_begin,
@@ -569,8 +1243,14 @@ struct Field
                 }
                 regionStorage.second.reset();
                 OPENPGL_ASSERT(regionStorage.first.isValid());
+                m_regionFitTimes[i] = regionTimer.elapsed() * 1e-3f;
             }
-        });
+#ifdef USE_EMBREE_PARALLEL
+        );
+#else
+        }, tbb::simple_partitioner());
+#endif
+        updateRegionFitTimeStatistics();
         OPENPGL_ASSERT(this->isValid());
     }
 
@@ -681,6 +1361,20 @@ struct Field
         stats->timeLastUpdateCopySamples = m_timeLastUpdateCopySamples;
         stats->timeLastUpdateSpatialStructureUpdate = m_timeLastUpdateSpatialStructureUpdate;
         stats->timeLastUpdateDirectionalDistriubtionUpdate = m_timeLastUpdateDirectionalDistriubtionUpdate;
+        stats->numLastUpdateRegions = m_numLastUpdateRegions;
+        stats->timeLastUpdateRegionFitMax = m_timeLastUpdateRegionFitMax;
+        stats->timeLastUpdateRegionFitTotal = m_timeLastUpdateRegionFitTotal;
+        stats->profilingStatistics = m_profilingStatistics;
+        stats->profilingStatistics.enabled = m_profiling;
+
+        if (m_lookUpCaches)
+        {
+            for (const auto &cache : *m_lookUpCaches)
+            {
+                stats->numLookUps += cache.numLookUps.load(std::memory_order_relaxed);
+                stats->numLookUpCacheHits += cache.numHits.load(std::memory_order_relaxed);
+            }
+        }
 
         stats->spatialStructureStatistics = m_spatialSubdiv.getStatistics();
 
@@ -701,9 +1395,16 @@ struct Field
             stats->directionalDistributionStatistics.averageNumberOfComponents += numDistributionComponents;
             stats->directionalDistributionStatistics.secondMomentNumberOfComponents += numDistributionComponents * numDistributionComponents;
         }
-        stats->directionalDistributionStatistics.averageNumberOfComponents /= float(numDistributions);
-        stats->directionalDistributionStatistics.secondMomentNumberOfComponents /= float(numDistributions);
-        stats->directionalDistributionStatistics.secondMomentNumberOfComponents = std::sqrt(stats->directionalDistributionStatistics.secondMomentNumberOfComponents);
+        if (numDistributions > 0)
+        {
+            stats->directionalDistributionStatistics.averageNumberOfComponents /= float(numDistributions);
+            stats->directionalDistributionStatistics.secondMomentNumberOfComponents /= float(numDistributions);
+            stats->directionalDistributionStatistics.secondMomentNumberOfComponents = std::sqrt(stats->directionalDistributionStatistics.secondMomentNumberOfComponents);
+        }
+        else
+        {
+            stats->directionalDistributionStatistics.minNumberOfComponents = 0.0f;
+        }
         return stats;
     }
 
@@ -723,7 +1424,26 @@ struct Field
     bool m_isSceneBoundsSet{false};
     BBox m_sceneBounds;
 
+    // settings for estimating the scene bounds from the samples (see estimateSceneBounds)
+    float m_sceneBoundsTrimPercentile{0.f};
+    float m_sceneBoundsEnlargement{3.f};
+
+    // maximum memory (bytes) of the field after an update (0 = no limit), see enforceMemoryBudget
+    size_t m_memoryBudget{0};
+    // the spatial structure type which selects the structure used for the look-ups:
+    // the binary KD-tree, its wide (4/8-ary) representation or the look-up grid
+    PGL_SPATIAL_STRUCTURE_TYPE m_spatialStructureType{PGL_SPATIAL_STRUCTURE_KDTREE};
+
+    // per-thread caches of the last (deterministic) look-up, reset each time the spatial structure changes
+    // they are only allocated if enabled since each instance allocates a native thread-local storage key
+    bool m_useLookUpCache{false};
+    using LookUpCaches = tbb::enumerable_thread_specific<typename SpatialStructure::LookUpCache, tbb::cache_aligned_allocator<typename SpatialStructure::LookUpCache>,
+                                                         tbb::ets_key_per_instance>;
+    mutable std::unique_ptr<LookUpCaches> m_lookUpCaches;
+
     bool m_initialized{false};
+    // if the field received samples since the start of the current streaming update
+    bool m_receivedSampleChunks{false};
 
     DirectionalDistributionFactory m_distributionFactory;
     DirectionalDistributionFactorySettings m_distributionFactorySettings;
@@ -739,15 +1459,38 @@ struct Field
 
     bool m_useStochasticNNLookUp{false};
     bool m_useISNNLookUp{false};
+    float m_knnUpdateTolerance{0.f};
     KNearestRegionsSearchTree<Vecsize> m_regionKNNSearchTree;
 
+    // indices of the regions touched (i.e., received samples or got split) during the last
+    // spatial structure update, filled by the spatial structure builder
+    tbb::concurrent_vector<uint32_t> m_touchedRegionIdxs;
+    // sorted and unique version of m_touchedRegionIdxs used for updating the regions
+    std::vector<uint32_t> m_updateRegionIdxs;
+    // estimated fitting costs per region, only valid for the regions in m_updateRegionIdxs
+    std::vector<size_t> m_updateRegionCosts;
+    // fitting time (ms) of each region in m_updateRegionIdxs during the last update
+    std::vector<float> m_regionFitTimes;
+    // fitting statistics of each region in m_updateRegionIdxs during the last update
+    std::vector<typename DirectionalDistributionFactory::FittingStatistics> m_regionFittingStatistics;
+
     SampleContainerInternal samples_;
     ZeroValueSampleContainerInternal zeroValueSamples_;
+    // the current chunk of a streaming update before it is appended to samples_ (see addSampleChunk)
+    SampleContainerInternal m_sampleChunk;
 
     float m_timeLastUpdate{0.f};
     float m_timeLastUpdateCopySamples{0.f};
     float m_timeLastUpdateSpatialStructureUpdate{0.f};
     float m_timeLastUpdateDirectionalDistriubtionUpdate{0.f};
+
+    size_t m_numLastUpdateRegions{0};
+    float m_timeLastUpdateRegionFitMax{0.f};
+    float m_timeLastUpdateRegionFitTotal{0.f};
+
+    // if detailed profiling statistics are collected during an update
+    bool m_profiling{false};
+    FieldProfilingStatistics m_profilingStatistics;
 };
 
 }  // namespace openpgl
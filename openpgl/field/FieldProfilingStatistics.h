@@ -0,0 +1,354 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <tbb/task_scheduler_observer.h>
+
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../openpgl_common.h"
+
+namespace openpgl
+{
+
+// timings of one phase of a field update
+struct ProfilingPhaseStatistics
+{
+    // wall clock time (ms)
+    float time{0.f};
+    // CPU time of the threads of the field's task arena (ms)
+    float cpuTime{0.f};
+    // average fraction of the threads of the arena which was busy during the phase
+    float threadUtilization{0.f};
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "{\"time\": " << jsonNumber(time) << ", \"cpuTime\": " << jsonNumber(cpuTime) << ", \"threadUtilization\": " << jsonNumber(threadUtilization) << "}";
+        return ss.str();
+    }
+};
+
+// measures the CPU time spent by the threads of the task arena it is created in: the local
+// observer is notified when a thread joins or leaves the arena and the CPU time of a thread
+// is only counted while it is in the arena, threads outside of the arena (e.g., render
+// threads querying the field during an asynchronous update) are not included
+class ArenaCPUTimer : public tbb::task_scheduler_observer
+{
+   public:
+    ArenaCPUTimer()
+    {
+        observe(true);
+    }
+
+    ArenaCPUTimer(const ArenaCPUTimer &) = delete;
+
+    ~ArenaCPUTimer()
+    {
+        observe(false);
+    }
+
+    // CPU time (in micro seconds) since the creation of the timer
+    double elapsed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        double time = m_exitedThreadsTime;
+        for (const auto &thread : m_threads)
+        {
+            time += thread.clock->now() - thread.entryTime;
+        }
+        return time;
+    }
+
+    void on_scheduler_entry(bool) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const std::thread::id id = std::this_thread::get_id();
+        for (auto &thread : m_threads)
+        {
+            if (thread.id == id)
+            {
+                thread.depth++;
+                return;
+            }
+        }
+        ArenaThread thread;
+        thread.id = id;
+        thread.clock.reset(new ThreadCPUClock());
+        thread.entryTime = thread.clock->now();
+        m_threads.push_back(std::move(thread));
+    }
+
+    void on_scheduler_exit(bool) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const std::thread::id id = std::this_thread::get_id();
+        for (size_t i = 0; i < m_threads.size(); i++)
+        {
+            if (m_threads[i].id == id)
+            {
+                if (--m_threads[i].depth == 0)
+                {
+                    m_exitedThreadsTime += m_threads[i].clock->now() - m_threads[i].entryTime;
+                    m_threads.erase(m_threads.begin() + i);
+                }
+                return;
+            }
+        }
+    }
+
+   private:
+    struct ArenaThread
+    {
+        std::thread::id id;
+        std::unique_ptr<ThreadCPUClock> clock;
+        double entryTime{0.0};
+        int depth{1};
+    };
+
+    std::mutex m_mutex;
+    std::vector<ArenaThread> m_threads;
+    // CPU time of the threads which already left the arena
+    double m_exitedThreadsTime{0.0};
+};
+
+// measures the wall clock and CPU time of a phase, the timer has to be created
+// inside the task arena which executes the phase
+struct ProfilingPhaseTimer
+{
+    ProfilingPhaseTimer(ProfilingPhaseStatistics &phaseStats, const size_t numThreads, const bool enabled) : m_phaseStats(phaseStats), m_numThreads(numThreads), m_enabled(enabled)
+    {
+        if (m_enabled)
+        {
+            m_cpuTimer.reset(new ArenaCPUTimer());
+            m_timer.reset();
+        }
+    }
+
+    ProfilingPhaseTimer(const ProfilingPhaseTimer &) = delete;
+
+    ~ProfilingPhaseTimer()
+    {
+        if (m_enabled)
+        {
+            m_phaseStats.time = m_timer.elapsed() * 1e-3f;
+            m_phaseStats.cpuTime = m_cpuTimer->elapsed() * 1e-3f;
+            m_phaseStats.threadUtilization = m_phaseStats.time > 0.f ? m_phaseStats.cpuTime / (m_phaseStats.time * float(m_numThreads)) : 0.f;
+        }
+    }
+
+   private:
+    ProfilingPhaseStatistics &m_phaseStats;
+    size_t m_numThreads{1};
+    bool m_enabled{false};
+    Timer m_timer;
+    std::unique_ptr<ArenaCPUTimer> m_cpuTimer;
+};
+
+// histogram with power-of-two sized bins: the first bin counts the
+// values in [0, 1) and bin i > 0 counts the values in [2^(i-1), 2^i)
+struct ProfilingHistogram
+{
+    static const int NUM_BINS = 20;
+    size_t counts[NUM_BINS];
+
+    ProfilingHistogram()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        std::fill(counts, counts + NUM_BINS, 0);
+    }
+
+    void addValue(const float value)
+    {
+        int bin = 0;
+        float upper = 1.f;
+        while (value >= upper && bin < NUM_BINS - 1)
+        {
+            upper *= 2.f;
+            bin++;
+        }
+        counts[bin]++;
+    }
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        for (int i = 0; i < NUM_BINS; i++)
+        {
+            ss << counts[i] << (i < NUM_BINS - 1 ? " " : "");
+        }
+        return ss.str();
+    }
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "[";
+        for (int i = 0; i < NUM_BINS; i++)
+        {
+            ss << counts[i] << (i < NUM_BINS - 1 ? ", " : "");
+        }
+        ss << "]";
+        return ss.str();
+    }
+};
+
+struct FieldProfilingStatistics
+{
+    bool enabled{false};
+    size_t numThreads{0};
+
+    ProfilingPhaseStatistics copySamples;
+    ProfilingPhaseStatistics partitioning;
+    ProfilingPhaseStatistics zeroValueInsertion;
+    ProfilingPhaseStatistics treeletRebuild;
+    ProfilingPhaseStatistics knnBuild;
+    ProfilingPhaseStatistics neighbourBuild;
+    ProfilingPhaseStatistics regionFitting;
+
+    // accumulated time (ms) over all regions spend in the different
+    // steps of the directional distribution fitting
+    float timeEM{0.f};
+    float timeSplit{0.f};
+    float timeMerge{0.f};
+    float timeDistanceUpdate{0.f};
+
+    // histograms over all fitted regions
+    ProfilingHistogram regionFitTimeHistogram;  // in micro seconds
+    ProfilingHistogram emIterationsHistogram;
+    ProfilingHistogram numSamplesHistogram;
+
+    void clear()
+    {
+        *this = FieldProfilingStatistics();
+    }
+
+    std::string headerCSVString() const
+    {
+        const std::string separator = " , ";
+        std::stringstream ss;
+        if (!enabled)
+            return ss.str();
+        ss << "FieldProfilingStatistics:" << separator;
+        ss << "numThreads" << separator;
+        auto phaseHeader = [&](const std::string &name) {
+            ss << name << "Time(ms)" << separator;
+            ss << name << "CPUTime(ms)" << separator;
+            ss << name << "ThreadUtilization" << separator;
+        };
+        phaseHeader("copySamples");
+        phaseHeader("partitioning");
+        phaseHeader("zeroValueInsertion");
+        phaseHeader("treeletRebuild");
+        phaseHeader("knnBuild");
+        phaseHeader("neighbourBuild");
+        phaseHeader("regionFitting");
+        ss << "timeEM(ms)" << separator;
+        ss << "timeSplit(ms)" << separator;
+        ss << "timeMerge(ms)" << separator;
+        ss << "timeDistanceUpdate(ms)" << separator;
+        ss << "regionFitTimeHistogram(us)" << separator;
+        ss << "emIterationsHistogram" << separator;
+        ss << "numSamplesHistogram" << separator;
+        return ss.str();
+    }
+
+    std::string toCSVString() const
+    {
+        const std::string separator = " , ";
+        std::stringstream ss;
+        if (!enabled)
+            return ss.str();
+        ss << " " << separator;
+        ss << numThreads << separator;
+        auto phaseValues = [&](const ProfilingPhaseStatistics &phase) {
+            ss << phase.time << separator;
+            ss << phase.cpuTime << separator;
+            ss << phase.threadUtilization << separator;
+        };
+        phaseValues(copySamples);
+        phaseValues(partitioning);
+        phaseValues(zeroValueInsertion);
+        phaseValues(treeletRebuild);
+        phaseValues(knnBuild);
+        phaseValues(neighbourBuild);
+        phaseValues(regionFitting);
+        ss << timeEM << separator;
+        ss << timeSplit << separator;
+        ss << timeMerge << separator;
+        ss << timeDistanceUpdate << separator;
+        ss << regionFitTimeHistogram.toString() << separator;
+        ss << emIterationsHistogram.toString() << separator;
+        ss << numSamplesHistogram.toString() << separator;
+        return ss.str();
+    }
+
+    std::string toString() const
+    {
+        const std::string tab = "\t";
+        std::stringstream ss;
+        if (!enabled)
+            return ss.str();
+        ss << "FieldProfilingStatistics: " << std::endl;
+        ss << tab << "numThreads               = " << numThreads << std::endl;
+        auto phaseString = [&](const std::string &name, const ProfilingPhaseStatistics &phase) {
+            ss << tab << name << " = " << phase.time << " ms (cpu: " << phase.cpuTime << " ms, utilization: " << phase.threadUtilization << ")" << std::endl;
+        };
+        phaseString("copySamples              ", copySamples);
+        phaseString("partitioning             ", partitioning);
+        phaseString("zeroValueInsertion       ", zeroValueInsertion);
+        phaseString("treeletRebuild           ", treeletRebuild);
+        phaseString("knnBuild                 ", knnBuild);
+        phaseString("neighbourBuild           ", neighbourBuild);
+        phaseString("regionFitting            ", regionFitting);
+        ss << tab << "timeEM                   = " << timeEM << " ms" << std::endl;
+        ss << tab << "timeSplit                = " << timeSplit << " ms" << std::endl;
+        ss << tab << "timeMerge                = " << timeMerge << " ms" << std::endl;
+        ss << tab << "timeDistanceUpdate       = " << timeDistanceUpdate << " ms" << std::endl;
+        ss << tab << "regionFitTimeHistogram   = " << regionFitTimeHistogram.toString() << " (us, log2 bins)" << std::endl;
+        ss << tab << "emIterationsHistogram    = " << emIterationsHistogram.toString() << " (log2 bins)" << std::endl;
+        ss << tab << "numSamplesHistogram      = " << numSamplesHistogram.toString() << " (log2 bins)" << std::endl;
+        return ss.str();
+    }
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "{";
+        ss << "\"enabled\": " << (enabled ? "true" : "false");
+        if (enabled)
+        {
+            ss << ", \"numThreads\": " << numThreads;
+            ss << ", \"phases\": {";
+            ss << "\"copySamples\": " << copySamples.toJSONString();
+            ss << ", \"partitioning\": " << partitioning.toJSONString();
+            ss << ", \"zeroValueInsertion\": " << zeroValueInsertion.toJSONString();
+            ss << ", \"treeletRebuild\": " << treeletRebuild.toJSONString();
+            ss << ", \"knnBuild\": " << knnBuild.toJSONString();
+            ss << ", \"neighbourBuild\": " << neighbourBuild.toJSONString();
+            ss << ", \"regionFitting\": " << regionFitting.toJSONString();
+            ss << "}";
+            ss << ", \"timeEM\": " << jsonNumber(timeEM);
+            ss << ", \"timeSplit\": " << jsonNumber(timeSplit);
+            ss << ", \"timeMerge\": " << jsonNumber(timeMerge);
+            ss << ", \"timeDistanceUpdate\": " << jsonNumber(timeDistanceUpdate);
+            ss << ", \"regionFitTimeHistogram\": " << regionFitTimeHistogram.toJSONString();
+            ss << ", \"emIterationsHistogram\": " << emIterationsHistogram.toJSONString();
+            ss << ", \"numSamplesHistogram\": " << numSamplesHistogram.toJSONString();
+        }
+        ss << "}";
+        return ss.str();
+    }
+};
+
+}  // namespace openpgl
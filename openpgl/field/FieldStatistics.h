@@ -9,6 +9,7 @@
 #include "../directional/DirectionalDistributionStatistics.h"
 #include "../openpgl_common.h"
 #include "../spatial/kdtree/KDTreeStatistics.h"
+#include "FieldProfilingStatistics.h"
 
 namespace openpgl
 {
@@ -28,8 +29,32 @@ struct FieldStatistics
     float timeLastUpdateSpatialStructureUpdate{0.f};
     float timeLastUpdateDirectionalDistriubtionUpdate{0.f};
 
+    // number of regions fitted/updated during the last update
+    size_t numLastUpdateRegions{0};
+    // the longest fitting time of a single region during the last update
+    float timeLastUpdateRegionFitMax{0.f};
+    // the accumulated fitting time of all regions during the last update (i.e., CPU time)
+    float timeLastUpdateRegionFitTotal{0.f};
+
+    // number of spatial structure look-ups since the last update and how many of them
+    // were resolved by the per-thread look-up caches (only counted if the caches are enabled)
+    size_t numLookUps{0};
+    size_t numLookUpCacheHits{0};
+
     SpatialStatistics spatialStructureStatistics;
     DirectionalDistributionStatistics directionalDistributionStatistics;
+    // only collected if profiling is enabled for the field
+    FieldProfilingStatistics profilingStatistics;
+
+    float getTimeLastUpdateRegionFitAverage() const
+    {
+        return numLastUpdateRegions > 0 ? timeLastUpdateRegionFitTotal / float(numLastUpdateRegions) : 0.f;
+    }
+
+    float getLookUpCacheHitRate() const
+    {
+        return numLookUps > 0 ? float(numLookUpCacheHits) / float(numLookUps) : 0.f;
+    }
 
     std::string headerCSVString() const
     {
@@ -50,6 +75,15 @@ struct FieldStatistics
         ss << spatialStructureStatistics.headerCSVString();
         ss << directionalDistributionStatistics.headerCSVString();
 
+        // columns added later are appended, so that readers parsing the columns by position keep working
+        ss << "numUpdateRegions" << separator;
+        ss << "timeRegionFitMax(ms)" << separator;
+        ss << "timeRegionFitAverage(ms)" << separator;
+        ss << "timeRegionFitTotal(ms)" << separator;
+        ss << "numLookUps" << separator;
+        ss << "lookUpCacheHitRate" << separator;
+        ss << profilingStatistics.headerCSVString();
+
         return ss.str();
     }
 
@@ -72,6 +106,14 @@ struct FieldStatistics
         ss << spatialStructureStatistics.toCSVString();
         ss << directionalDistributionStatistics.toCSVString();
 
+        ss << numLastUpdateRegions << separator;
+        ss << timeLastUpdateRegionFitMax << separator;
+        ss << getTimeLastUpdateRegionFitAverage() << separator;
+        ss << timeLastUpdateRegionFitTotal << separator;
+        ss << numLookUps << separator;
+        ss << getLookUpCacheHitRate() << separator;
+        ss << profilingStatistics.toCSVString();
+
         return ss.str();
     }
 
@@ -90,12 +132,45 @@ struct FieldStatistics
         ss << tab << "timeCopySamples = " << timeLastUpdateCopySamples << " ms" << std::endl;
         ss << tab << "timeSpatialStructureUpdate = " << timeLastUpdateSpatialStructureUpdate << " ms" << std::endl;
         ss << tab << "timeDirectionalDistriubtionUpdate= " << timeLastUpdateDirectionalDistriubtionUpdate << " ms" << std::endl;
+        ss << tab << "numUpdateRegions = " << numLastUpdateRegions << std::endl;
+        ss << tab << "timeRegionFitMax = " << timeLastUpdateRegionFitMax << " ms" << std::endl;
+        ss << tab << "timeRegionFitAverage = " << getTimeLastUpdateRegionFitAverage() << " ms" << std::endl;
+        ss << tab << "timeRegionFitTotal = " << timeLastUpdateRegionFitTotal << " ms" << std::endl;
+        ss << tab << "numLookUps = " << numLookUps << std::endl;
+        ss << tab << "lookUpCacheHitRate = " << getLookUpCacheHitRate() << std::endl;
 
         ss << spatialStructureStatistics.toString();
         ss << directionalDistributionStatistics.toString();
+        ss << profilingStatistics.toString();
 
         return ss.str();
     }
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "{";
+        ss << "\"numCacheRegions\": " << numCacheRegions;
+        ss << ", \"numCacheRegionsReserved\": " << numCacheRegionsReserved;
+        ss << ", \"sizePerCacheRegions\": " << sizePerCacheRegions;
+        ss << ", \"sizeAllCacheRegionsUsed\": " << sizeAllCacheRegionsUsed;
+        ss << ", \"sizeAllCacheRegionsReserved\": " << sizeAllCacheRegionsReserved;
+        ss << ", \"timeUpdate\": " << jsonNumber(timeLastUpdate);
+        ss << ", \"timeCopySamples\": " << jsonNumber(timeLastUpdateCopySamples);
+        ss << ", \"timeSpatialStructureUpdate\": " << jsonNumber(timeLastUpdateSpatialStructureUpdate);
+        ss << ", \"timeDirectionalDistriubtionUpdate\": " << jsonNumber(timeLastUpdateDirectionalDistriubtionUpdate);
+        ss << ", \"numUpdateRegions\": " << numLastUpdateRegions;
+        ss << ", \"timeRegionFitMax\": " << jsonNumber(timeLastUpdateRegionFitMax);
+        ss << ", \"timeRegionFitAverage\": " << jsonNumber(getTimeLastUpdateRegionFitAverage());
+        ss << ", \"timeRegionFitTotal\": " << jsonNumber(timeLastUpdateRegionFitTotal);
+        ss << ", \"numLookUps\": " << numLookUps;
+        ss << ", \"numLookUpCacheHits\": " << numLookUpCacheHits;
+        ss << ", \"spatialStructureStatistics\": " << spatialStructureStatistics.toJSONString();
+        ss << ", \"directionalDistributionStatistics\": " << directionalDistributionStatistics.toJSONString();
+        ss << ", \"profilingStatistics\": " << profilingStatistics.toJSONString();
+        ss << "}";
+        return ss.str();
+    }
 };
 
 }  // namespace openpgl
@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include <tbb/task_arena.h>
+
+#include <memory>
+
 #include "../data/SampleDataStorage.h"
 #include "../directional/ISurfaceSamplingDistribution.h"
 #include "../directional/IVolumeSamplingDistribution.h"
@@ -22,10 +26,16 @@ struct ISurfaceVolumeField
 
     virtual bool initSurfaceSamplingDistribution(ISurfaceSamplingDistribution *surfaceSamplingDistribution, const Point3 &position, float *sample1D) const = 0;
 
+    virtual void initSurfaceSamplingDistributions(ISurfaceSamplingDistribution **surfaceSamplingDistributions, const Point3 *positions, float *sample1Ds, bool *initialized,
+                                                  size_t numDistributions) const = 0;
+
     virtual IVolumeSamplingDistribution *newVolumeSamplingDistribution() const = 0;
 
     virtual bool initVolumeSamplingDistribution(IVolumeSamplingDistribution *volumeSamplingDistribution, const Point3 &position, float *sample1D) const = 0;
 
+    virtual void initVolumeSamplingDistributions(IVolumeSamplingDistribution **volumeSamplingDistributions, const Point3 *positions, float *sample1Ds, bool *initialized,
+                                                 size_t numDistributions) const = 0;
+
     virtual void setSceneBounds(const openpgl::BBox &sceneBounds) = 0;
 
     virtual openpgl::BBox getSceneBounds() const = 0;
@@ -36,6 +46,22 @@ struct ISurfaceVolumeField
 
     virtual void updateFieldVolume(SampleContainer &samplesVolume) = 0;
 
+    virtual void updateFieldAsync(SampleContainer &samplesSurface, SampleContainer &samplesVolume) = 0;
+
+    virtual bool isUpdateFinished() const = 0;
+
+    virtual void waitForUpdate() = 0;
+
+    virtual void beginUpdate() = 0;
+
+    virtual void addSampleChunk(SampleContainer &samplesSurface, SampleContainer &samplesVolume) = 0;
+
+    virtual void endUpdate() = 0;
+
+    virtual ISurfaceVolumeField *newSnapshot() = 0;
+
+    virtual ISurfaceVolumeField *newReplica(const std::shared_ptr<tbb::task_arena> &arena) = 0;
+
     virtual void resetField() = 0;
 
     virtual PGL_SPATIAL_STRUCTURE_TYPE getSpatialStructureType() const = 0;
@@ -3,6 +3,16 @@
 
 #pragma once
 
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "Field.h"
 #include "FieldStatistics.h"
 #include "ISurfaceVolumeField.h"
@@ -20,21 +30,254 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
     using FieldType = Field<Vecsize, TDirectionalDistributionFactory, TSpatialStructureBuilder>;
     using SampleContainer = SampleDataStorage::SampleContainer;
 
+    // number of positions the batched look-ups process at once
+    static const size_t LOOKUP_BATCH_SIZE = 64;
+
+    // number of counters the look-ups on a buffer are distributed over
+    static const int NUM_LOOKUP_COUNTERS = 16;
+
+    // number of buffer slots, besides the front buffer the update can choose between
+    // the remaining slots if look-ups are still running on the previous front buffer
+    static const int NUM_BUFFER_SLOTS = 4;
+
    public:
     using Settings = typename FieldType::Settings;
     using RegionType = typename FieldType::RegionType;
     using DirectionalDistribution = typename FieldType::DirectionalDistribution;
 
+   private:
+    // one complete state (snapshot) of the surface and volume fields
+    // used for double buffering during asynchronous updates.
+    // The surface and the volume field are reference counted and can be shared between
+    // buffers (e.g., with a snapshot or, if only one of them was updated, with the previous
+    // front buffer), a shared field is never modified but copied first (copy-on-write).
+    struct FieldBuffer
+    {
+        FieldBuffer() : surfaceField(new FieldType()), volumeField(new FieldType())
+        {
+            surfaceField->setIsSurface(true);
+            volumeField->setIsSurface(false);
+        }
+
+        FieldBuffer(const Settings &settings) : surfaceField(new FieldType(settings)), volumeField(new FieldType(settings))
+        {
+            surfaceField->setIsSurface(true);
+            volumeField->setIsSurface(false);
+        }
+
+        // shares the fields of the given buffer, they are copied on their first modification
+        void shareFrom(const FieldBuffer &b)
+        {
+            iteration = b.iteration;
+            totalSPP = b.totalSPP;
+            surfaceField = b.surfaceField;
+            volumeField = b.volumeField;
+        }
+
+        // copies the fields which are going to be updated, the other ones are shared with the given buffer
+        void copyFrom(const FieldBuffer &b, const bool copySurface = true, const bool copyVolume = true)
+        {
+            iteration = b.iteration;
+            totalSPP = b.totalSPP;
+            if (copySurface)
+                exclusiveSurfaceField().copyFrom(*b.surfaceField);
+            else
+                surfaceField = b.surfaceField;
+            if (copyVolume)
+                exclusiveVolumeField().copyFrom(*b.volumeField);
+            else
+                volumeField = b.volumeField;
+        }
+
+        // returns the field for modifying it, a field shared with another buffer is copied first
+        FieldType &privateSurfaceField()
+        {
+            return privateField(surfaceField);
+        }
+
+        FieldType &privateVolumeField()
+        {
+            return privateField(volumeField);
+        }
+
+        // returns the field for overwriting it, a field shared with another buffer is
+        // replaced by an empty one instead of being copied (e.g., for reused back buffers)
+        FieldType &exclusiveSurfaceField()
+        {
+            return exclusiveField(surfaceField, true);
+        }
+
+        FieldType &exclusiveVolumeField()
+        {
+            return exclusiveField(volumeField, false);
+        }
+
+        size_t iteration{0};
+        size_t totalSPP{0};
+
+        std::shared_ptr<FieldType> surfaceField;
+        std::shared_ptr<FieldType> volumeField;
+
+       private:
+        static FieldType &privateField(std::shared_ptr<FieldType> &field)
+        {
+            if (field.use_count() > 1)
+            {
+                std::shared_ptr<FieldType> copy(new FieldType());
+                copy->copyFrom(*field);
+                field = copy;
+            }
+            // synchronize with the last accesses of the buffers which released the field
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return *field;
+        }
+
+        static FieldType &exclusiveField(std::shared_ptr<FieldType> &field, const bool isSurface)
+        {
+            if (field.use_count() > 1)
+            {
+                field = std::shared_ptr<FieldType>(new FieldType());
+                field->setIsSurface(isSurface);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return *field;
+        }
+    };
+
+    // a slot holding one of the buffers of the field, the slots (and their look-up counters)
+    // live as long as the field, only the buffers they point to are exchanged
+    struct BufferSlot
+    {
+        void setBuffer(const std::shared_ptr<FieldBuffer> &b)
+        {
+            buffer = b;
+            distributionRef = b ? std::make_shared<std::shared_ptr<FieldBuffer>>(b) : nullptr;
+        }
+
+        // the buffer is also referenced by a snapshot of the field
+        // (besides the slot the buffer is held by distributionRef)
+        bool isSharedWithSnapshot() const
+        {
+            return buffer.use_count() > 2;
+        }
+
+        // the buffer is referenced by a snapshot or by sampling distributions which were initialized from it
+        bool isReferenced() const
+        {
+            return isSharedWithSnapshot() || distributionRef.use_count() > 1;
+        }
+
+        // number of look-ups which currently read from the slot
+        size_t numLookUps() const
+        {
+            size_t numLookUps = 0;
+            for (int i = 0; i < NUM_LOOKUP_COUNTERS; i++)
+            {
+                numLookUps += lookUpCounters[i].count.load();
+            }
+            return numLookUps;
+        }
+
+        std::shared_ptr<FieldBuffer> buffer;
+        // handed to the sampling distributions initialized from the buffer, it keeps the buffer
+        // (and the regions the distributions point to) alive until they are re-initialized or destroyed
+        std::shared_ptr<const void> distributionRef;
+
+        // the look-ups of the rendering threads are counted in multiple counters
+        // (one per cache line), so that the threads do not contend for the same counter
+        struct LookUpCounter
+        {
+            mutable std::atomic<int> count{0};
+            char padding[64 - sizeof(std::atomic<int>)];
+        };
+        LookUpCounter lookUpCounters[NUM_LOOKUP_COUNTERS];
+    };
+
+    // pins the slot of the front buffer for the duration of a look-up, the buffer
+    // of a slot is only exchanged or modified (see privateBackBuffer) once all
+    // look-ups which started on the slot have finished
+    class FrontBufferLookUp
+    {
+       public:
+        FrontBufferLookUp(const SurfaceVolumeField &field) : m_counterIdx(lookUpCounterIdx())
+        {
+            int idx = field.m_front.load(std::memory_order_acquire);
+            while (true)
+            {
+                field.m_slots[idx].lookUpCounters[m_counterIdx].count.fetch_add(1);
+                // if the front buffer was swapped before the look-up was counted,
+                // the updater might not have seen the look-up and we need to retry
+                const int front = field.m_front.load();
+                if (front == idx)
+                {
+                    break;
+                }
+                field.m_slots[idx].lookUpCounters[m_counterIdx].count.fetch_sub(1, std::memory_order_release);
+                idx = front;
+            }
+            m_slot = &field.m_slots[idx];
+        }
+
+        ~FrontBufferLookUp()
+        {
+            m_slot->lookUpCounters[m_counterIdx].count.fetch_sub(1, std::memory_order_release);
+        }
+
+        const FieldBuffer &buffer() const
+        {
+            return *m_slot->buffer;
+        }
+
+        // lets the sampling distribution keep the buffer its region belongs to alive,
+        // the reference is only exchanged once per distribution and buffer
+        template <typename TSamplingDistribution>
+        void retainBuffer(TSamplingDistribution *samplingDistribution) const
+        {
+            if (samplingDistribution->getRegionOwner() != m_slot->distributionRef.get())
+            {
+                samplingDistribution->setRegionOwner(m_slot->distributionRef);
+            }
+        }
+
+       private:
+        static int lookUpCounterIdx()
+        {
+            static std::atomic<int> numThreads{0};
+            static thread_local int counterIdx = numThreads.fetch_add(1, std::memory_order_relaxed) % NUM_LOOKUP_COUNTERS;
+            return counterIdx;
+        }
+
+        const BufferSlot *m_slot{nullptr};
+        int m_counterIdx{0};
+    };
+
    public:
-    SurfaceVolumeField() = default;
+    // all updates of the field are executed inside the given task arena (e.g., the one of the device),
+    // if no arena is given the field creates its own one
+    SurfaceVolumeField(const std::shared_ptr<tbb::task_arena> &arena = nullptr) : m_arena(arena ? arena : std::make_shared<tbb::task_arena>())
+    {
+        m_slots[0].setBuffer(std::shared_ptr<FieldBuffer>(new FieldBuffer()));
+    }
 
-    SurfaceVolumeField(const Settings &settings) : m_surfaceField(settings), m_volumeField(settings)
+    SurfaceVolumeField(const Settings &settings, const std::shared_ptr<tbb::task_arena> &arena = nullptr)
+        : m_arena(arena ? arena : std::make_shared<tbb::task_arena>())
     {
-        m_surfaceField.setIsSurface(true);
-        m_volumeField.setIsSurface(false);
+        m_slots[0].setBuffer(std::shared_ptr<FieldBuffer>(new FieldBuffer(settings)));
     }
 
-    ~SurfaceVolumeField() override {}
+   private:
+    // creates a snapshot sharing the given buffer
+    SurfaceVolumeField(const std::shared_ptr<FieldBuffer> &buffer, const std::shared_ptr<tbb::task_arena> &arena) : m_arena(arena)
+    {
+        m_slots[0].setBuffer(buffer);
+    }
+
+   public:
+    ~SurfaceVolumeField() override
+    {
+        // the background update task references this field
+        waitForUpdateTask();
+    }
 
     ISurfaceSamplingDistribution *newSurfaceSamplingDistribution() const override
     {
@@ -45,7 +288,8 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
     {
         TSurfaceSamplingDistribution *_surfaceSamplingDistribution = (TSurfaceSamplingDistribution *)surfaceSamplingDistribution;
         uint32_t id = -1;
-        const RegionType *region = m_surfaceField.getRegion(position, sample1D, id);
+        FrontBufferLookUp lookUp(*this);
+        const RegionType *region = lookUp.buffer().surfaceField->getRegion(position, sample1D, id);
         if (!region || !region->valid)
         {
             return false;
@@ -54,9 +298,37 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
         _surfaceSamplingDistribution->init(distribution, position);
         _surfaceSamplingDistribution->setId(id);
         _surfaceSamplingDistribution->setRegion(region);
+        lookUp.retainBuffer(_surfaceSamplingDistribution);
         return true;
     }
 
+    void initSurfaceSamplingDistributions(ISurfaceSamplingDistribution **surfaceSamplingDistributions, const Point3 *positions, float *sample1Ds, bool *initialized,
+                                          size_t numDistributions) const override
+    {
+        FrontBufferLookUp lookUp(*this);
+        const FieldType &field = *lookUp.buffer().surfaceField;
+        const RegionType *regions[LOOKUP_BATCH_SIZE];
+        uint32_t ids[LOOKUP_BATCH_SIZE];
+        for (size_t i = 0; i < numDistributions; i += LOOKUP_BATCH_SIZE)
+        {
+            const size_t batchSize = std::min(size_t(LOOKUP_BATCH_SIZE), numDistributions - i);
+            field.getRegions(batchSize, positions + i, sample1Ds ? sample1Ds + i : nullptr, regions, ids);
+            for (size_t k = 0; k < batchSize; k++)
+            {
+                const RegionType *region = regions[k];
+                initialized[i + k] = region && region->valid;
+                if (initialized[i + k])
+                {
+                    TSurfaceSamplingDistribution *_surfaceSamplingDistribution = (TSurfaceSamplingDistribution *)surfaceSamplingDistributions[i + k];
+                    _surfaceSamplingDistribution->init(&region->distribution, positions[i + k]);
+                    _surfaceSamplingDistribution->setId(ids[k]);
+                    _surfaceSamplingDistribution->setRegion(region);
+                    lookUp.retainBuffer(_surfaceSamplingDistribution);
+                }
+            }
+        }
+    }
+
     IVolumeSamplingDistribution *newVolumeSamplingDistribution() const override
     {
         return new TVolumeSamplingDistribution();
@@ -66,7 +338,8 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
     {
         TVolumeSamplingDistribution *_volumeSamplingDistribution = (TVolumeSamplingDistribution *)volumeSamplingDistribution;
         uint32_t id = -1;
-        const RegionType *region = m_volumeField.getRegion(position, sample1D, id);
+        FrontBufferLookUp lookUp(*this);
+        const RegionType *region = lookUp.buffer().volumeField->getRegion(position, sample1D, id);
         if (!region || !region->valid)
         {
             return false;
@@ -75,99 +348,264 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
         _volumeSamplingDistribution->init(distribution, position);
         _volumeSamplingDistribution->setId(id);
         _volumeSamplingDistribution->setRegion(region);
+        lookUp.retainBuffer(_volumeSamplingDistribution);
         return true;
     }
 
+    void initVolumeSamplingDistributions(IVolumeSamplingDistribution **volumeSamplingDistributions, const Point3 *positions, float *sample1Ds, bool *initialized,
+                                         size_t numDistributions) const override
+    {
+        FrontBufferLookUp lookUp(*this);
+        const FieldType &field = *lookUp.buffer().volumeField;
+        const RegionType *regions[LOOKUP_BATCH_SIZE];
+        uint32_t ids[LOOKUP_BATCH_SIZE];
+        for (size_t i = 0; i < numDistributions; i += LOOKUP_BATCH_SIZE)
+        {
+            const size_t batchSize = std::min(size_t(LOOKUP_BATCH_SIZE), numDistributions - i);
+            field.getRegions(batchSize, positions + i, sample1Ds ? sample1Ds + i : nullptr, regions, ids);
+            for (size_t k = 0; k < batchSize; k++)
+            {
+                const RegionType *region = regions[k];
+                initialized[i + k] = region && region->valid;
+                if (initialized[i + k])
+                {
+                    TVolumeSamplingDistribution *_volumeSamplingDistribution = (TVolumeSamplingDistribution *)volumeSamplingDistributions[i + k];
+                    _volumeSamplingDistribution->init(region->getDistribution(positions[i + k]), positions[i + k]);
+                    _volumeSamplingDistribution->setId(ids[k]);
+                    _volumeSamplingDistribution->setRegion(region);
+                    lookUp.retainBuffer(_volumeSamplingDistribution);
+                }
+            }
+        }
+    }
+
     void setSceneBounds(const openpgl::BBox &sceneBounds) override
     {
+        prepareUpdate();
         openpgl::BBox scaledSceneBounds = sceneBounds;
         scaledSceneBounds.enlarge_by(1.01f);
-        m_surfaceField.setSceneBounds(scaledSceneBounds);
-        m_volumeField.setSceneBounds(scaledSceneBounds);
+        FieldBuffer &buffer = privateFront();
+        buffer.privateSurfaceField().setSceneBounds(scaledSceneBounds);
+        buffer.privateVolumeField().setSceneBounds(scaledSceneBounds);
     }
 
     openpgl::BBox getSceneBounds() const override
     {
-        openpgl::BBox sceneBounds = m_surfaceField.getSceneBounds();
-        sceneBounds.extend(m_volumeField.getSceneBounds());
+        FrontBufferLookUp lookUp(*this);
+        const FieldBuffer &buffer = lookUp.buffer();
+        openpgl::BBox sceneBounds = buffer.surfaceField->getSceneBounds();
+        sceneBounds.extend(buffer.volumeField->getSceneBounds());
         return sceneBounds;
     }
 
     void updateField(SampleContainer &samplesSurface, SampleContainer &samplesVolume) override
     {
+        prepareUpdate();
 #if TBB_INTERFACE_VERSION < 12010
         // we need to initialize the task_scheduler in the context to avoid
         // asyncronous deconsrution of the implicit initialized tbb::arenas and tbb::streams
         tbb::task_scheduler_init anonymous;
 #endif
-        if (samplesSurface.samples.size() > 0)
-        {
-            if (!m_surfaceField.isInitialized())
+        FieldBuffer &buffer = privateFront();
+        const bool updateSurface = samplesSurface.samples.size() > 0;
+        const bool updateVolume = samplesVolume.samples.size() > 0;
+        m_arena->execute([&]() {
+            if (updateSurface)
             {
-                m_surfaceField.buildField(samplesSurface);
+                buffer.privateSurfaceField().copySamples(samplesSurface);
             }
-            else
+            if (updateVolume)
             {
-                m_surfaceField.updateField(samplesSurface);
+                buffer.privateVolumeField().copySamples(samplesVolume);
             }
+            buildOrUpdateFields(buffer, updateSurface, updateVolume);
+        });
+        buffer.iteration++;
+    }
+
+    void updateFieldSurface(SampleContainer &samplesSurface) override
+    {
+        prepareUpdate();
+        FieldBuffer &buffer = privateFront();
+        if (samplesSurface.samples.size() > 0)
+        {
+            m_arena->execute([&]() {
+                buffer.privateSurfaceField().copySamples(samplesSurface);
+                buildOrUpdateField(buffer.privateSurfaceField());
+            });
         }
+        buffer.iteration++;
+    }
+
+    void updateFieldVolume(SampleContainer &samplesVolume) override
+    {
+        prepareUpdate();
+        FieldBuffer &buffer = privateFront();
         if (samplesVolume.samples.size() > 0)
         {
-            if (!m_volumeField.isInitialized())
+            m_arena->execute([&]() {
+                buffer.privateVolumeField().copySamples(samplesVolume);
+                buildOrUpdateField(buffer.privateVolumeField());
+            });
+        }
+        buffer.iteration++;
+    }
+
+    void updateFieldAsync(SampleContainer &samplesSurface, SampleContainer &samplesVolume) override
+    {
+        prepareUpdate();
+
+        const int backIdx = privateBackBuffer();
+        FieldBuffer *frontBuffer = m_slots[frontIdx()].buffer.get();
+        FieldBuffer *backBuffer = m_slots[backIdx].buffer.get();
+
+        // the samples are copied before returning so that the
+        // sample storage can be cleared and refilled while the update is running
+        const bool updateSurface = samplesSurface.samples.size() > 0;
+        const bool updateVolume = samplesVolume.samples.size() > 0;
+        m_arena->execute([&]() {
+            if (updateSurface)
             {
-                m_volumeField.buildField(samplesVolume);
+                backBuffer->exclusiveSurfaceField().copySamples(samplesSurface);
             }
-            else
+            if (updateVolume)
             {
-                m_volumeField.updateField(samplesVolume);
+                backBuffer->exclusiveVolumeField().copySamples(samplesVolume);
             }
-        }
-        m_iteration++;
-    }
+        });
 
-    void updateFieldSurface(SampleContainer &samplesSurface) override
-    {
-        if (samplesSurface.samples.size() > 0)
         {
-            if (!m_surfaceField.isInitialized())
+            std::lock_guard<std::mutex> lock(m_updateMutex);
+            m_updateRunning = true;
+        }
+
+        m_arena->enqueue([this, frontBuffer, backBuffer, backIdx, updateSurface, updateVolume]() {
+            try
             {
-                m_surfaceField.buildField(samplesSurface);
+                // the front buffer is only read, so it can still be queried while the back buffer is updated
+                // only the fields which are updated are copied, the other ones are shared with the front buffer
+                backBuffer->copyFrom(*frontBuffer, updateSurface, updateVolume);
+                buildOrUpdateFields(*backBuffer, updateSurface, updateVolume);
+                backBuffer->iteration++;
+                m_front.store(backIdx);
             }
-            else
+            catch (...)
             {
-                m_surfaceField.updateField(samplesSurface);
+                m_updateException = std::current_exception();
             }
+
+            {
+                std::lock_guard<std::mutex> lock(m_updateMutex);
+                m_updateRunning = false;
+            }
+            m_updateFinished.notify_all();
+        });
+    }
+
+    void beginUpdate() override
+    {
+        prepareUpdate();
+        const int backIdx = privateBackBuffer();
+        m_arena->execute([&]() {
+            m_slots[backIdx].buffer->copyFrom(*m_slots[frontIdx()].buffer);
+        });
+        m_streamingIdx = backIdx;
+    }
+
+    void addSampleChunk(SampleContainer &samplesSurface, SampleContainer &samplesVolume) override
+    {
+        if (m_streamingIdx < 0)
+        {
+            throw std::runtime_error("error: addSampleChunk called without beginUpdate!");
         }
-        m_iteration++;
+        FieldBuffer &buffer = *m_slots[m_streamingIdx].buffer;
+        const bool updateSurface = samplesSurface.samples.size() > 0;
+        const bool updateVolume = samplesVolume.samples.size() > 0;
+        // the update runs in the arena of the field to not compete with the
+        // rendering threads which still query the front buffer
+        m_arena->execute([&]() {
+            addSampleChunks(buffer, samplesSurface, samplesVolume, updateSurface, updateVolume);
+        });
     }
 
-    void updateFieldVolume(SampleContainer &samplesVolume) override
+    void endUpdate() override
     {
-        if (samplesVolume.samples.size() > 0)
+        if (m_streamingIdx < 0)
         {
-            if (!m_volumeField.isInitialized())
-            {
-                m_volumeField.buildField(samplesVolume);
-            }
-            else
-            {
-                m_volumeField.updateField(samplesVolume);
-            }
+            throw std::runtime_error("error: endUpdate called without beginUpdate!");
+        }
+        FieldBuffer *buffer = m_slots[m_streamingIdx].buffer.get();
+        // the distributions of the regions are fitted to all samples of the chunks
+        m_arena->execute([&]() {
+            endSampleChunks(*buffer);
+        });
+        buffer->iteration++;
+        m_front.store(m_streamingIdx);
+        m_streamingIdx = -1;
+    }
+
+    ISurfaceVolumeField *newSnapshot() override
+    {
+        waitForUpdate();
+        return new SurfaceVolumeField(m_slots[frontIdx()].buffer, m_arena);
+    }
+
+    ISurfaceVolumeField *newReplica(const std::shared_ptr<tbb::task_arena> &arena) override
+    {
+        waitForUpdate();
+        FrontBufferLookUp lookUp(*this);
+        const FieldBuffer &source = lookUp.buffer();
+        SurfaceVolumeField *replica = nullptr;
+        // the replica is allocated and copied by a thread inside the target arena, if
+        // this arena is pinned to a NUMA node its memory is placed on this node (first-touch)
+        arena->execute([&]() {
+            replica = new SurfaceVolumeField(arena);
+            replica->m_slots[0].buffer->copyFrom(source);
+        });
+        return replica;
+    }
+
+    bool isUpdateFinished() const override
+    {
+        std::lock_guard<std::mutex> lock(m_updateMutex);
+        return !m_updateRunning;
+    }
+
+    void waitForUpdate() override
+    {
+        waitForUpdateTask();
+        if (m_updateException)
+        {
+            std::exception_ptr updateException = m_updateException;
+            m_updateException = nullptr;
+            std::rethrow_exception(updateException);
         }
-        m_iteration++;
     }
 
     void resetField() override
     {
-        m_iteration = 0;
-        m_totalSPP = 0;
-        m_surfaceField.resetField();
-        m_volumeField.resetField();
+        prepareUpdate();
+        FieldBuffer &buffer = privateFront();
+        buffer.iteration = 0;
+        buffer.totalSPP = 0;
+        buffer.privateSurfaceField().resetField();
+        buffer.privateVolumeField().resetField();
     }
 
     PGL_SPATIAL_STRUCTURE_TYPE getSpatialStructureType() const override
     {
-        return FieldType::SpatialStructureBuilder::SPATIAL_STRUCTURE_TYPE;
+        FrontBufferLookUp lookUp(*this);
+        return lookUp.buffer().surfaceField->getSpatialStructureType();
+    }
+
+    // selects the structure used for the look-ups (e.g., the wide representation or the look-up grid
+    // of the KD-tree), needs to be set before the field is deserialized or build
+    void setSpatialStructureType(const PGL_SPATIAL_STRUCTURE_TYPE spatialStructureType)
+    {
+        prepareUpdate();
+        FieldBuffer &buffer = privateFront();
+        buffer.privateSurfaceField().setSpatialStructureType(spatialStructureType);
+        buffer.privateVolumeField().setSpatialStructureType(spatialStructureType);
     }
 
     PGL_DIRECTIONAL_DISTRIBUTION_TYPE getDirectionalDistributionType() const override
@@ -177,32 +615,39 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
 
     size_t getIteration() const override
     {
-        return m_iteration;
+        FrontBufferLookUp lookUp(*this);
+        return lookUp.buffer().iteration;
     }
 
     void serialize(std::ostream &os) const override
     {
-        os.write(reinterpret_cast<const char *>(&m_iteration), sizeof(m_iteration));
-        os.write(reinterpret_cast<const char *>(&m_totalSPP), sizeof(m_totalSPP));
-        m_surfaceField.serialize(os);
-        m_volumeField.serialize(os);
+        FrontBufferLookUp lookUp(*this);
+        const FieldBuffer &buffer = lookUp.buffer();
+        os.write(reinterpret_cast<const char *>(&buffer.iteration), sizeof(buffer.iteration));
+        os.write(reinterpret_cast<const char *>(&buffer.totalSPP), sizeof(buffer.totalSPP));
+        buffer.surfaceField->serialize(os);
+        buffer.volumeField->serialize(os);
     }
 
     void deserialize(std::istream &is) override
     {
-        is.read(reinterpret_cast<char *>(&m_iteration), sizeof(m_iteration));
-        is.read(reinterpret_cast<char *>(&m_totalSPP), sizeof(m_totalSPP));
-        m_surfaceField.deserialize(is);
-        m_volumeField.deserialize(is);
+        prepareUpdate();
+        FieldBuffer &buffer = privateFront();
+        is.read(reinterpret_cast<char *>(&buffer.iteration), sizeof(buffer.iteration));
+        is.read(reinterpret_cast<char *>(&buffer.totalSPP), sizeof(buffer.totalSPP));
+        buffer.privateSurfaceField().deserialize(is);
+        buffer.privateVolumeField().deserialize(is);
     }
 
     virtual bool validate(const bool checkSurface, const bool checkVolume) const override
     {
+        FrontBufferLookUp lookUp(*this);
+        const FieldBuffer &buffer = lookUp.buffer();
         bool valid = true;
-        if (m_surfaceField.isInitialized())
-            valid = valid & m_surfaceField.isValid();
-        if (m_volumeField.isInitialized())
-            valid = valid & m_volumeField.isValid();
+        if (buffer.surfaceField->isInitialized())
+            valid = valid & buffer.surfaceField->isValid();
+        if (buffer.volumeField->isInitialized())
+            valid = valid & buffer.volumeField->isValid();
         return valid;
     }
 
@@ -216,7 +661,7 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
 
         os.write(FIELD_FILE_HEADER_STRING, strlen(FIELD_FILE_HEADER_STRING) + 1);
 
-        auto spatialStructureType = FieldType::SpatialStructureBuilder::SPATIAL_STRUCTURE_TYPE;
+        auto spatialStructureType = getSpatialStructureType();
         os.write(reinterpret_cast<const char *>(&spatialStructureType), sizeof(spatialStructureType));
         auto directionalDistributionType = FieldType::DirectionalDistributionFactory::DIRECTIONAL_DISTRIBUTION_TYPE;
         os.write(reinterpret_cast<const char *>(&directionalDistributionType), sizeof(directionalDistributionType));
@@ -231,8 +676,16 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
     {
         bool equal = true;
         const SurfaceVolumeField *fieldB = dynamic_cast<const SurfaceVolumeField *>(b);
-        if (!fieldB || m_iteration != fieldB->m_iteration || m_totalSPP != fieldB->m_totalSPP || !m_surfaceField.operator==(fieldB->m_surfaceField) ||
-            !m_volumeField.operator==(fieldB->m_volumeField))
+        if (!fieldB)
+        {
+            return false;
+        }
+        FrontBufferLookUp lookUpA(*this);
+        FrontBufferLookUp lookUpB(*fieldB);
+        const FieldBuffer &bufferA = lookUpA.buffer();
+        const FieldBuffer &bufferB = lookUpB.buffer();
+        if (bufferA.iteration != bufferB.iteration || bufferA.totalSPP != bufferB.totalSPP || !bufferA.surfaceField->operator==(*bufferB.surfaceField) ||
+            !bufferA.volumeField->operator==(*bufferB.volumeField))
         {
             equal = false;
         }
@@ -241,22 +694,227 @@ struct SurfaceVolumeField : public ISurfaceVolumeField
 
     FieldStatistics *getSurfaceStatistics() const override
     {
-        FieldStatistics *stats = m_surfaceField.getStatistics();
+        FrontBufferLookUp lookUp(*this);
+        FieldStatistics *stats = lookUp.buffer().surfaceField->getStatistics();
         return stats;
     }
 
     FieldStatistics *getVolumeStatistics() const override
     {
-        FieldStatistics *stats = m_volumeField.getStatistics();
+        FrontBufferLookUp lookUp(*this);
+        FieldStatistics *stats = lookUp.buffer().volumeField->getStatistics();
         return stats;
     }
 
    private:
-    size_t m_iteration{0};
-    size_t m_totalSPP{0};
+    static void buildOrUpdateField(FieldType &field)
+    {
+        if (!field.isInitialized())
+        {
+            field.buildField();
+        }
+        else
+        {
+            field.updateField();
+        }
+    }
+
+    static void addSampleChunks(FieldBuffer &buffer, const SampleContainer &samplesSurface, const SampleContainer &samplesVolume, const bool updateSurface,
+                                const bool updateVolume)
+    {
+        if (updateSurface && updateVolume && !isProfilingEnabled(buffer))
+        {
+            tbb::task_group updateGroup;
+            updateGroup.run([&buffer, &samplesSurface]() {
+                buffer.privateSurfaceField().addSampleChunk(samplesSurface);
+            });
+            updateGroup.run_and_wait([&buffer, &samplesVolume]() {
+                buffer.privateVolumeField().addSampleChunk(samplesVolume);
+            });
+        }
+        else
+        {
+            if (updateSurface)
+            {
+                buffer.privateSurfaceField().addSampleChunk(samplesSurface);
+            }
+            if (updateVolume)
+            {
+                buffer.privateVolumeField().addSampleChunk(samplesVolume);
+            }
+        }
+    }
+
+    static void endSampleChunks(FieldBuffer &buffer)
+    {
+        if (!isProfilingEnabled(buffer))
+        {
+            tbb::task_group updateGroup;
+            updateGroup.run([&buffer]() {
+                buffer.privateSurfaceField().endSampleChunks();
+            });
+            updateGroup.run_and_wait([&buffer]() {
+                buffer.privateVolumeField().endSampleChunks();
+            });
+        }
+        else
+        {
+            buffer.privateSurfaceField().endSampleChunks();
+            buffer.privateVolumeField().endSampleChunks();
+        }
+    }
+
+    // the surface and the volume field are independent of each other, if both
+    // need an update they are processed as concurrent tasks to overlap
+    // the serial phases (e.g., KD-tree finalize, KNN rebuild) of each update
+    // if profiling is enabled they are updated one after the other, otherwise the
+    // measured CPU time of a phase would include the work of the other field
+    static void buildOrUpdateFields(FieldBuffer &buffer, const bool updateSurface, const bool updateVolume)
+    {
+        if (updateSurface && updateVolume && !isProfilingEnabled(buffer))
+        {
+            tbb::task_group updateGroup;
+            updateGroup.run([&buffer]() {
+                buildOrUpdateField(buffer.privateSurfaceField());
+            });
+            updateGroup.run_and_wait([&buffer]() {
+                buildOrUpdateField(buffer.privateVolumeField());
+            });
+        }
+        else
+        {
+            if (updateSurface)
+            {
+                buildOrUpdateField(buffer.privateSurfaceField());
+            }
+            if (updateVolume)
+            {
+                buildOrUpdateField(buffer.privateVolumeField());
+            }
+        }
+    }
+
+    static bool isProfilingEnabled(const FieldBuffer &buffer)
+    {
+        return buffer.surfaceField->isProfilingEnabled() || buffer.volumeField->isProfilingEnabled();
+    }
+
+    int frontIdx() const
+    {
+        return m_front.load(std::memory_order_acquire);
+    }
+
+    // returns the front buffer for modifying it, if the buffer is shared with a snapshot the slot
+    // gets a new buffer which shares the fields with the snapshot, the fields are only copied
+    // once they are modified (e.g., an update of the surface field does not copy the volume field)
+    FieldBuffer &privateFront()
+    {
+        BufferSlot &slot = m_slots[frontIdx()];
+        if (slot.isSharedWithSnapshot())
+        {
+            std::shared_ptr<FieldBuffer> buffer(new FieldBuffer());
+            buffer->shareFrom(*slot.buffer);
+            slot.setBuffer(buffer);
+        }
+        return *slot.buffer;
+    }
+
+    // returns the slot the next state of the field can be build in, a slot is only
+    // chosen once all look-ups which started on it (e.g., on a previous front buffer) have finished.
+    // The buffer of the slot is reused if no snapshot or sampling distribution references it,
+    // otherwise the slot gets a new buffer and the old one is freed with its last reference
+    // (i.e., when all distributions initialized from it are re-initialized or destroyed).
+    int privateBackBuffer()
+    {
+        const int front = frontIdx();
+        int idx = -1;
+        while (idx < 0)
+        {
+            for (int i = 0; i < NUM_BUFFER_SLOTS; i++)
+            {
+                if (i == front || m_slots[i].numLookUps() > 0)
+                {
+                    continue;
+                }
+                if (idx < 0 || (m_slots[i].buffer && !m_slots[i].isReferenced()))
+                {
+                    idx = i;
+                }
+            }
+            if (idx < 0)
+            {
+                // all spare slots are read by look-ups which started before the last
+                // swaps, look-ups never block, so this lasts at most a single look-up
+                std::this_thread::yield();
+            }
+        }
+
+        // the field keeps at most the front and the back buffer,
+        // the buffers of all other idle slots are released
+        for (int i = 0; i < NUM_BUFFER_SLOTS; i++)
+        {
+            if (i != front && i != idx && m_slots[i].buffer && m_slots[i].numLookUps() == 0)
+            {
+                m_slots[i].setBuffer(nullptr);
+            }
+        }
+
+        BufferSlot &slot = m_slots[idx];
+        if (!slot.buffer || slot.isReferenced())
+        {
+            slot.setBuffer(std::shared_ptr<FieldBuffer>(new FieldBuffer()));
+        }
+        // the reference counts are read relaxed, synchronize with the last accesses
+        // of the distributions which released the reused buffer
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return idx;
+    }
 
-    FieldType m_surfaceField;
-    FieldType m_volumeField;
+    // waits for a running asynchronous update before the field is modified,
+    // modifying the field during a streaming update is not allowed
+    void prepareUpdate()
+    {
+        waitForUpdate();
+        if (m_streamingIdx >= 0)
+        {
+            throw std::runtime_error("error: the field can not be modified during a streaming update (see beginUpdate/endUpdate)!");
+        }
+    }
+
+    void waitForUpdateTask()
+    {
+        std::unique_lock<std::mutex> lock(m_updateMutex);
+        m_updateFinished.wait(lock, [this]() {
+            return !m_updateRunning;
+        });
+    }
+
+   private:
+    // the fields are double buffered: queries always go to the front buffer while an
+    // asynchronous update builds the next state in the back buffer, which is then published
+    // by swapping the index of the front slot. The back buffer is only allocated on the first asynchronous update.
+    // All queries pin the front slot for their duration (see FrontBufferLookUp), so that the
+    // previous front buffer is not overwritten while a query still reads from it. Sampling distributions
+    // keep the buffer they were initialized from alive, a buffer they still reference is never reused.
+    // The buffers can be shared with snapshots of the field (see newSnapshot), shared buffers are
+    // never modified. The copy-on-write is done per field (surface and volume) and not per region:
+    // an update refits all regions which received samples and rebuilds the spatial structures
+    // of the field anyway, so that a per region sharing would save little memory but would need
+    // an extra indirection on every region look-up.
+    BufferSlot m_slots[NUM_BUFFER_SLOTS];
+    std::atomic<int> m_front{0};
+
+    // the arena all (synchronous and asynchronous) updates are executed in,
+    // it is usually shared between all fields of a device
+    std::shared_ptr<tbb::task_arena> m_arena;
+    mutable std::mutex m_updateMutex;
+    std::condition_variable m_updateFinished;
+    bool m_updateRunning{false};
+    std::exception_ptr m_updateException;
+
+    // the slot of the back buffer which receives the sample chunks of a
+    // streaming update, it is published as the front buffer by endUpdate()
+    int m_streamingIdx{-1};
 };
 
 }  // namespace openpgl
@@ -46,6 +46,39 @@ extern "C"
         size_t minSamples{100};
         size_t maxSamples{PGL_TREE_MAX_SAMPLE_PER_LEAF};
         size_t maxDepth{32};
+        // if the scene bounds are not set explicitly they are estimated from the samples
+        // of the first training iteration: the bounds are trimmed to the given percentile
+        // of the sample positions (per dimension, 0 = no trimming) ...
+        float sceneBoundsTrimPercentile{0.f};
+        // ... and enlarged by the given factor around their center
+        float sceneBoundsEnlargement{3.f};
+        // the maximum memory (in bytes) the regions, the tree, the region search structures and the
+        // samples of each field (surface and volume) can occupy after an update, if it is exceeded
+        // regions are merged back into their parents until they only use 80% of the budget left by
+        // the samples (0 = no limit)
+        size_t memoryBudget{0};
+        // the number of candidate split planes per axis (bins) evaluated when a leaf is split, the plane
+        // which separates the sample directions best is chosen (0 = split at the sample mean along
+        // the axis of the largest variance)
+        size_t numSplitBins{0};
+        // if the initial tree is built in one pass from the Morton order of the sample positions
+        // instead of recursively partitioning the samples (speeds up the first build for large
+        // sample counts, the leaves are split at the centers of the Morton grid cells)
+        bool mortonBuild{false};
+        // if each thread caches the path of its last look-up into the spatial structure, spatially
+        // coherent queries (e.g., neighbouring pixels) then often skip the traversal
+        // (replaces the wide nodes or the look-up grid for single look-ups, see SetSpatialStructureArgLookUpCache)
+        bool lookUpCache{false};
+        // after an update of the tree only the KNN neighbours of the new regions, of the regions whose
+        // mean moved by more than the given fraction of the distance to their closest neighbour and of
+        // the neighbours of both are recomputed (0 = all regions whose mean moved are recomputed)
+        float knnUpdateTolerance{0.f};
+        // the number of neighbours precomputed for each region (at most 8, or 16 on 16-wide devices)
+        // and the number of closest ones a KNN look-up randomly selects from (at most knnNumNeighbours),
+        // larger values result in a smoother spatial filtering of the guiding distributions
+        // (on 16-wide devices more than 8 neighbours double the size of the neighbour table)
+        size_t knnNumNeighbours{8};
+        size_t knnK{4};
     };
 
     struct PGLVMMFactoryArguments
@@ -114,6 +147,7 @@ extern "C"
     struct PGLDebugArguments
     {
         bool fitRegions{true};
+        bool profiling{false};
     };
 
     struct PGLFieldArguments
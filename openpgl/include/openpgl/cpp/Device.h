@@ -28,9 +28,17 @@ struct Device
      * for different compute architechtures. On the CPU the device can be
      * optimized for different SIMD architechtures (e.g., SSE4, AVX, or AVX-512)
      *
+     * Each device owns its own task arena in which all updates of the fields created
+     * by this device are executed. The thread limit of a device therefore does not
+     * affect the parallelism of the application or of other devices.
+     *
      * @param deviceType The device optimization type.
+     * @param numThreads The maximum number of threads used by the device (0 = all available threads).
+     * @param numaNode The NUMA node the threads of the device are pinned to (-1 = no pinning).
+     * If the node does not exist or NUMA pinning is not supported by the TBB version
+     * OpenPGL is build with, the parameter is ignored.
      */
-    Device(PGL_DEVICE_TYPE deviceType, size_t numThreads = 0);
+    Device(PGL_DEVICE_TYPE deviceType, size_t numThreads = 0, int numaNode = -1);
 
     ~Device();
 
@@ -46,9 +54,9 @@ struct Device
 /// Implementation
 ////////////////////////////////////////////////////////////
 
-OPENPGL_INLINE Device::Device(PGL_DEVICE_TYPE deviceType, size_t numThreads)
+OPENPGL_INLINE Device::Device(PGL_DEVICE_TYPE deviceType, size_t numThreads, int numaNode)
 {
-    m_deviceHandle = pglNewDevice(deviceType, numThreads);
+    m_deviceHandle = pglNewDeviceOnNumaNode(deviceType, numThreads, numaNode);
 }
 
 OPENPGL_INLINE Device::~Device()
@@ -47,6 +47,32 @@ struct Field
      */
     Field(Device *device, const std::string &fieldFileName);
 
+    /**
+     * @brief Creates a snapshot of the current state of another guiding field (e.g., to start the
+     * training of the next frame of an animation from the guiding information of the previous one).
+     *
+     * The snapshot is created in memory and shares the guiding information (e.g., regions and spatial
+     * structure) with the other field until one of them is updated or reset (copy-on-write). The surface
+     * and the volume guiding information are copied separately, e.g., updating only the surface
+     * guiding information of one of the fields does not copy its volume guiding information.
+     *
+     * @param field The Field the snapshot is created from.
+     */
+    explicit Field(const Field *field);
+
+    /**
+     * @brief Creates a replica of the current state of another guiding field on a (different) device.
+     *
+     * In contrast to a snapshot, the replica is a deep copy whose memory is allocated by the threads
+     * of the given device. When the device is pinned to a NUMA node, the replica is placed in the memory
+     * of this node. On multi-socket systems a replica per socket avoids remote memory accesses
+     * of the rendering threads during the guiding lookups (e.g., InitSurfaceSamplingDistribution).
+     *
+     * @param device The Device the replica is created on.
+     * @param field The Field the replica is created from.
+     */
+    Field(Device *device, const Field *field);
+
     ~Field();
 
     Field(const Field &) = delete;
@@ -102,6 +128,59 @@ struct Field
      */
     void UpdateVolume(const SampleStorage &sampleStorage);
 
+    /**
+     * @brief Starts an asynchronous update of the surface and volume radiance fields.
+     *
+     * The samples are copied from the SampleStorage before this function returns, so the
+     * storage can be cleared and refilled while the update is running. The update is performed
+     * on a second copy (back buffer) of the Field. Sampling distributions can still be initialized
+     * from the current approximation until the updated one is published, which happens atomically
+     * when the update finishes. A sampling distribution keeps the approximation it was initialized from
+     * (including the region returned by GetRegion) alive until it is initialized again or released,
+     * so it stays valid during the following asynchronous updates. The synchronous @ref Update and
+     * @ref Reset still modify the current approximation in place.
+     * Note: keeping the back buffer doubles the memory footprint of the Field, an approximation
+     * which is still referenced by sampling distributions is freed once these are re-initialized.
+     *
+     * @param sampleStorage
+     */
+    void UpdateAsync(const SampleStorage &sampleStorage);
+
+    /// Returns if the last asynchronous update (see @ref UpdateAsync) has finished.
+    bool IsUpdateFinished() const;
+
+    /// Blocks until the last asynchronous update (see @ref UpdateAsync) has finished.
+    void WaitForUpdate();
+
+    /**
+     * @brief Starts a streaming update of the surface and volume radiance fields.
+     *
+     * Instead of passing all samples of a training iteration at once (see @ref Update), the samples
+     * can be passed in chunks using @ref AddSampleChunk, which spreads the costs of partitioning the
+     * samples into the spatial structure over the render pass and allows reusing a small SampleStorage.
+     * The directional distributions are fitted once to all samples of the chunks by @ref EndUpdate.
+     * Like @ref UpdateAsync, the update is performed on a second copy (back buffer) of the Field,
+     * sampling distributions are initialized from the current approximation until @ref EndUpdate
+     * publishes the updated one. The Field can not be updated or reset until @ref EndUpdate is called.
+     */
+    void BeginUpdate();
+
+    /**
+     * @brief Partitions the samples of the SampleStorage into the spatial structure (i.e., splits its
+     * leaves) and stores them for fitting the directional distributions in @ref EndUpdate.
+     *
+     * The function returns after the chunk is processed, so the storage can be cleared and refilled
+     * for the next chunk. If the Field was not trained before, the samples of all chunks are used to
+     * build the spatial structure (e.g., to estimate the scene bounds) in @ref EndUpdate.
+     *
+     * @param sampleStorage
+     */
+    void AddSampleChunk(const SampleStorage &sampleStorage);
+
+    /// Finishes the streaming update (see @ref BeginUpdate), fits the directional distributions of all
+    /// regions which received samples and publishes the updated approximation.
+    void EndUpdate();
+
     void Reset();
 
     /// Returns the number of performed training iterations.
@@ -154,6 +233,26 @@ OPENPGL_INLINE Field::Field(Device *device, const std::string &fieldFileName)
         throw std::runtime_error("could not load field from file!");
 }
 
+OPENPGL_INLINE Field::Field(const Field *field)
+{
+    OPENPGL_ASSERT(field);
+    OPENPGL_ASSERT(field->m_fieldHandle);
+    m_fieldHandle = pglFieldNewSnapshot(field->m_fieldHandle);
+    if (!m_fieldHandle)
+        throw std::runtime_error("could not create snapshot of field!");
+}
+
+OPENPGL_INLINE Field::Field(Device *device, const Field *field)
+{
+    OPENPGL_ASSERT(device);
+    OPENPGL_ASSERT(device->m_deviceHandle);
+    OPENPGL_ASSERT(field);
+    OPENPGL_ASSERT(field->m_fieldHandle);
+    m_fieldHandle = pglDeviceNewFieldReplica(device->m_deviceHandle, field->m_fieldHandle);
+    if (!m_fieldHandle)
+        throw std::runtime_error("could not create replica of field!");
+}
+
 OPENPGL_INLINE Field::~Field()
 {
     OPENPGL_ASSERT(m_fieldHandle);
@@ -203,6 +302,42 @@ OPENPGL_INLINE void Field::UpdateVolume(const SampleStorage &sampleStorage)
     pglFieldUpdateVolume(m_fieldHandle, sampleStorage.m_sampleStorageHandle);
 }
 
+OPENPGL_INLINE void Field::UpdateAsync(const SampleStorage &sampleStorage)
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    pglFieldUpdateAsync(m_fieldHandle, sampleStorage.m_sampleStorageHandle);
+}
+
+OPENPGL_INLINE bool Field::IsUpdateFinished() const
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    return pglFieldIsUpdateFinished(m_fieldHandle);
+}
+
+OPENPGL_INLINE void Field::WaitForUpdate()
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    pglFieldWaitForUpdate(m_fieldHandle);
+}
+
+OPENPGL_INLINE void Field::BeginUpdate()
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    pglFieldBeginUpdate(m_fieldHandle);
+}
+
+OPENPGL_INLINE void Field::AddSampleChunk(const SampleStorage &sampleStorage)
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    pglFieldAddSampleChunk(m_fieldHandle, sampleStorage.m_sampleStorageHandle);
+}
+
+OPENPGL_INLINE void Field::EndUpdate()
+{
+    OPENPGL_ASSERT(m_fieldHandle);
+    pglFieldEndUpdate(m_fieldHandle);
+}
+
 OPENPGL_INLINE void Field::Reset()
 {
     OPENPGL_ASSERT(m_fieldHandle);
@@ -46,6 +46,35 @@ struct FieldConfig
      */
     void SetSpatialStructureArgMaxDepth(const size_t maxDepth);
 
+    /**
+     * @brief Sets the number of candidate split planes per axis (e.g., 8) which are evaluated when a leaf
+     * of the tree structure is split. The plane which separates the directions of the samples best is chosen,
+     * which places the leaves along directional discontinuities (e.g., shadow boundaries).
+     *
+     * @param numSplitBins The number of bins per axis (0 = split at the mean of the samples along the axis of their largest variance).
+     */
+    void SetSpatialStructureArgSplitBins(const size_t numSplitBins);
+
+    /**
+     * @brief Enables or disables building the initial tree structure in one pass from the Morton order
+     * of the sample positions. This reduces the time of the first update for large numbers of samples,
+     * but the leaves are split at the centers of a regular grid instead of at the means of their samples.
+     *
+     * @param mortonBuild If the Morton order bulk build is used (default: false).
+     */
+    void SetSpatialStructureArgMortonBuild(const bool mortonBuild);
+
+    /**
+     * @brief Enables or disables the per-thread look-up caches of the spatial structure. Each thread remembers
+     * the path of its last look-up, a query which falls into the same region only needs a bounding box test and
+     * other queries restart the traversal from the deepest common node. The hit rate is reported in the field statistics.
+     * The caches replace the traversal of the single look-ups of all KD-tree types: for PGL_SPATIAL_STRUCTURE_KDTREE_WIDE
+     * the wide nodes are not build, for PGL_SPATIAL_STRUCTURE_KDTREE_GRID the look-up grid is only used by the batched look-ups.
+     *
+     * @param lookUpCache If the look-up caches are used (default: false).
+     */
+    void SetSpatialStructureArgLookUpCache(const bool lookUpCache);
+
     /**
      * @brief Enables or disables K-nearest neighbor lookup when querying a guiding cache.
      *
@@ -60,6 +89,48 @@ struct FieldConfig
      */
     void SetUseKnnIsLookup(const bool useKnnIsLookup);
 
+    /**
+     * @brief Sets when the KNN neighbours of a region are recomputed after an update of the spatial structure.
+     * Only new regions and regions whose mean moved by more than the given fraction of the distance to their closest
+     * neighbour are recomputed together with their neighbours, the other regions keep their previous position.
+     *
+     * @param tolerance The relative tolerance (default: 0, all regions whose mean moved are recomputed). Larger values
+     * reduce the update costs but the neighbours are only approximated.
+     */
+    void SetKnnUpdateTolerance(const float tolerance);
+
+    /**
+     * @brief Sets the number of neighbours of the KNN-lookup. For each region its closest regions are precomputed and
+     * a lookup randomly selects one of the K closest of them to the lookup position.
+     * On 16-wide devices more than 8 neighbours double the memory of the precomputed neighbours
+     * (16 entries are stored per region instead of 8).
+     *
+     * @param numNeighbours The number of precomputed neighbours per region (default: 8, at most 8 or 16 on 16-wide devices).
+     * @param k The number of closest neighbours a lookup selects from (default: 4, at most numNeighbours).
+     */
+    void SetKnnNeighbours(const size_t numNeighbours, const size_t k);
+
+    /**
+     * @brief Sets how the scene bounds are estimated from the samples of the first training iteration
+     * if they are not set explicitly using Field::SetSceneBounds.
+     *
+     * @param trimPercentile The bounds only contain the given percentile of the sample positions (per dimension)
+     * to ignore outliers (e.g., 0.01 ignores the 1% smallest and largest coordinates). 0 disables the trimming.
+     * @param enlargement The factor the bounds are enlarged by around their center. Smaller factors lead to
+     * shallower trees but samples of later iterations outside of the bounds are ignored.
+     */
+    void SetSceneBoundsEstimation(const float trimPercentile, const float enlargement);
+
+    /**
+     * @brief Sets the maximum memory the guiding caches (regions), the spatial structure, the region search
+     * structures and the training samples of the surface and the volume field can occupy. If the budget is
+     * exceeded after an update, the regions which received the fewest samples are merged with their siblings
+     * until the regions only occupy 80% of the budget left by the samples.
+     *
+     * @param memoryBudget The memory budget in bytes per field (0 = no limit).
+     */
+    void SetMemoryBudget(const size_t memoryBudget);
+
     /**
      * @brief For debugging and benchmarking the update of the spatial structure this function can disable
      * the training of the directional distribution during the update iterations.
@@ -68,6 +139,14 @@ struct FieldConfig
      */
     void SetDebugArgFitRegions(const bool fitRegions);
 
+    /**
+     * @brief Enables the collection of detailed timings (e.g., per update phase, thread utilization
+     * and per-region fitting histograms) which are reported via the FieldStatistics.
+     *
+     * @param profiling If the detailed profiling statistics should be collected during an update iteration.
+     */
+    void SetDebugArgProfiling(const bool profiling);
+
     friend struct openpgl::cpp::Field;
 
    private:
@@ -89,11 +168,31 @@ OPENPGL_INLINE void FieldConfig::SetDebugArgFitRegions(const bool fitRegions)
     m_args.debugArguments.fitRegions = fitRegions;
 }
 
+OPENPGL_INLINE void FieldConfig::SetDebugArgProfiling(const bool profiling)
+{
+    m_args.debugArguments.profiling = profiling;
+}
+
 OPENPGL_INLINE void FieldConfig::SetSpatialStructureArgMaxDepth(const size_t maxDepth)
 {
     reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->maxDepth = maxDepth;
 }
 
+OPENPGL_INLINE void FieldConfig::SetSpatialStructureArgSplitBins(const size_t numSplitBins)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->numSplitBins = numSplitBins;
+}
+
+OPENPGL_INLINE void FieldConfig::SetSpatialStructureArgMortonBuild(const bool mortonBuild)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->mortonBuild = mortonBuild;
+}
+
+OPENPGL_INLINE void FieldConfig::SetSpatialStructureArgLookUpCache(const bool lookUpCache)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->lookUpCache = lookUpCache;
+}
+
 OPENPGL_INLINE void FieldConfig::SetUseKnnLookup(const bool useKnnLookup)
 {
     reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->knnLookup = useKnnLookup;
@@ -104,5 +203,27 @@ OPENPGL_INLINE void FieldConfig::SetUseKnnIsLookup(const bool useKnnIsLookup)
     reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->isKnnLookup = useKnnIsLookup;
 }
 
+OPENPGL_INLINE void FieldConfig::SetKnnUpdateTolerance(const float tolerance)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->knnUpdateTolerance = tolerance;
+}
+
+OPENPGL_INLINE void FieldConfig::SetKnnNeighbours(const size_t numNeighbours, const size_t k)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->knnNumNeighbours = numNeighbours;
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->knnK = k;
+}
+
+OPENPGL_INLINE void FieldConfig::SetSceneBoundsEstimation(const float trimPercentile, const float enlargement)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->sceneBoundsTrimPercentile = trimPercentile;
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->sceneBoundsEnlargement = enlargement;
+}
+
+OPENPGL_INLINE void FieldConfig::SetMemoryBudget(const size_t memoryBudget)
+{
+    reinterpret_cast<PGLKDTreeArguments *>(m_args.spatialSturctureArguments)->memoryBudget = memoryBudget;
+}
+
 }  // namespace cpp
 }  // namespace openpgl
\ No newline at end of file
@@ -45,6 +45,14 @@ struct FieldStatistics
      */
     std::string ToCSVString() const;
 
+    /**
+     * @brief Returns all statistics, including the profiling statistics
+     * (see FieldConfig::SetDebugArgProfiling), as a JSON object.
+     *
+     * @return std::string
+     */
+    std::string ToJSONString() const;
+
    private:
     PGLFieldStatistics m_fieldStatisticsHandle{nullptr};
 };
@@ -103,5 +111,18 @@ OPENPGL_INLINE std::string FieldStatistics::ToCSVString() const
 
     return str;
 }
+
+OPENPGL_INLINE std::string FieldStatistics::ToJSONString() const
+{
+    OPENPGL_ASSERT(m_fieldStatisticsHandle);
+    PGLString pglString = pglFieldStatisticsToJSONString(m_fieldStatisticsHandle);
+    std::string str = "";
+    if (pglString.m_str)
+        str = std::string(pglString.m_str);
+
+    pglReleaseString(pglString);
+
+    return str;
+}
 }  // namespace cpp
 }  // namespace openpgl
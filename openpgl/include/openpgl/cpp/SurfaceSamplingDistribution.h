@@ -55,6 +55,23 @@ struct SurfaceSamplingDistribution
      */
     bool Init(const Field *field, const pgl_point3f &pos, float &sample1D);
 
+    /**
+     * @brief Initializes multiple guiding distributions for the given positions at once.
+     *
+     * The batched version of @ref Init which looks up the guiding field for several
+     * positions at once (e.g., all shading points of a wavefront) using a SIMD
+     * packet traversal of the spatial structure of the field.
+     *
+     * @param field The guiding field of the scene.
+     * @param distributions The SurfaceSamplingDistributions which are initialized.
+     * @param positions The positions the guiding distributions are queried for.
+     * @param sample1Ds Random numbers used if a stochastic look-up is used (can be nullptr).
+     * @param initialized Returns for each distribution if it was initialized.
+     * @param numDistributions The number of distributions/positions.
+     */
+    static void Init(const Field *field, SurfaceSamplingDistribution *const *distributions, const pgl_point3f *positions, float *sample1Ds, bool *initialized,
+                     size_t numDistributions);
+
     /**
      * @brief Clears/resets the internal representation of the guiding distribution.
      *
@@ -242,6 +259,24 @@ OPENPGL_INLINE bool SurfaceSamplingDistribution::Init(const Field *field, const
     return pglFieldInitSurfaceSamplingDistribution(field->m_fieldHandle, m_surfaceSamplingDistributionHandle, pos, &sample1D);
 }
 
+OPENPGL_INLINE void SurfaceSamplingDistribution::Init(const Field *field, SurfaceSamplingDistribution *const *distributions, const pgl_point3f *positions, float *sample1Ds,
+                                                   bool *initialized, size_t numDistributions)
+{
+    OPENPGL_ASSERT(field->m_fieldHandle);
+    const size_t batchSize = 64;
+    PGLSurfaceSamplingDistribution handles[batchSize];
+    for (size_t i = 0; i < numDistributions; i += batchSize)
+    {
+        const size_t num = std::min(batchSize, numDistributions - i);
+        for (size_t k = 0; k < num; k++)
+        {
+            OPENPGL_ASSERT(distributions[i + k]->m_surfaceSamplingDistributionHandle);
+            handles[k] = distributions[i + k]->m_surfaceSamplingDistributionHandle;
+        }
+        pglFieldInitSurfaceSamplingDistributions(field->m_fieldHandle, handles, positions + i, sample1Ds ? sample1Ds + i : nullptr, initialized + i, num);
+    }
+}
+
 OPENPGL_INLINE void SurfaceSamplingDistribution::ApplyCosineProduct(const pgl_vec3f &normal)
 {
     OPENPGL_ASSERT(m_surfaceSamplingDistributionHandle);
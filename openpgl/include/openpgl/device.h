@@ -22,10 +22,14 @@ typedef ManagedObject Device;
 
     OPENPGL_CORE_INTERFACE PGLDevice pglNewDevice(PGL_DEVICE_TYPE deviceType, size_t numThreads);
 
+    OPENPGL_CORE_INTERFACE PGLDevice pglNewDeviceOnNumaNode(PGL_DEVICE_TYPE deviceType, size_t numThreads, int numaNode);
+
     OPENPGL_CORE_INTERFACE PGLField pglDeviceNewField(PGLDevice device, PGLFieldArguments args);
 
     OPENPGL_CORE_INTERFACE PGLField pglDeviceNewFieldFromFile(PGLDevice device, const char *fieldFileName);
 
+    OPENPGL_CORE_INTERFACE PGLField pglDeviceNewFieldReplica(PGLDevice device, PGLField field);
+
     OPENPGL_CORE_INTERFACE void pglReleaseDevice(PGLDevice device);
 
 #ifdef __cplusplus
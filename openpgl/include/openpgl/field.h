@@ -48,6 +48,20 @@ typedef ManagedObject Field;
 
     OPENPGL_CORE_INTERFACE void pglFieldUpdateVolume(PGLField field, PGLSampleStorage sampleStorage);
 
+    OPENPGL_CORE_INTERFACE void pglFieldUpdateAsync(PGLField field, PGLSampleStorage sampleStorage);
+
+    OPENPGL_CORE_INTERFACE bool pglFieldIsUpdateFinished(PGLField field);
+
+    OPENPGL_CORE_INTERFACE void pglFieldWaitForUpdate(PGLField field);
+
+    OPENPGL_CORE_INTERFACE void pglFieldBeginUpdate(PGLField field);
+
+    OPENPGL_CORE_INTERFACE void pglFieldAddSampleChunk(PGLField field, PGLSampleStorage sampleStorage);
+
+    OPENPGL_CORE_INTERFACE void pglFieldEndUpdate(PGLField field);
+
+    OPENPGL_CORE_INTERFACE PGLField pglFieldNewSnapshot(PGLField field);
+
     OPENPGL_CORE_INTERFACE void pglFieldReset(PGLField field);
 
     OPENPGL_CORE_INTERFACE PGLSurfaceSamplingDistribution pglFieldNewSurfaceSamplingDistribution(PGLField field);
@@ -55,11 +69,17 @@ typedef ManagedObject Field;
     OPENPGL_CORE_INTERFACE bool pglFieldInitSurfaceSamplingDistribution(PGLField field, PGLSurfaceSamplingDistribution surfaceSamplingDistribution, pgl_point3f position,
                                                                         float *sample1D);
 
+    OPENPGL_CORE_INTERFACE void pglFieldInitSurfaceSamplingDistributions(PGLField field, PGLSurfaceSamplingDistribution *surfaceSamplingDistributions, const pgl_point3f *positions,
+                                                                         float *sample1Ds, bool *initialized, size_t numDistributions);
+
     OPENPGL_CORE_INTERFACE PGLVolumeSamplingDistribution pglFieldNewVolumeSamplingDistribution(PGLField field);
 
     OPENPGL_CORE_INTERFACE bool pglFieldInitVolumeSamplingDistribution(PGLField field, PGLVolumeSamplingDistribution volumeSamplingDistribution, pgl_point3f position,
                                                                        float *sample1D);
 
+    OPENPGL_CORE_INTERFACE void pglFieldInitVolumeSamplingDistributions(PGLField field, PGLVolumeSamplingDistribution *volumeSamplingDistributions, const pgl_point3f *positions,
+                                                                        float *sample1Ds, bool *initialized, size_t numDistributions);
+
     OPENPGL_CORE_INTERFACE bool pglFieldValidate(PGLField field);
 
     OPENPGL_CORE_INTERFACE bool pglFieldCompare(PGLField fieldA, PGLField fieldB);
@@ -26,6 +26,8 @@ typedef ManagedObject FieldStatistics;
 
     OPENPGL_CORE_INTERFACE PGLString pglFieldStatisticsToCSVString(PGLFieldStatistics fieldStatistics);
 
+    OPENPGL_CORE_INTERFACE PGLString pglFieldStatisticsToJSONString(PGLFieldStatistics fieldStatistics);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
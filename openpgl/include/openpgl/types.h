@@ -2,7 +2,9 @@
 
 enum PGL_SPATIAL_STRUCTURE_TYPE
 {
-    PGL_SPATIAL_STRUCTURE_KDTREE = 0
+    PGL_SPATIAL_STRUCTURE_KDTREE = 0,
+    PGL_SPATIAL_STRUCTURE_KDTREE_WIDE,
+    PGL_SPATIAL_STRUCTURE_KDTREE_GRID
 };
 
 enum PGL_DIRECTIONAL_DISTRIBUTION_TYPE
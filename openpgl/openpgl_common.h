@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <ostream>
 
 #if defined(__WIN32__) || (defined(__MACOSX__) && !defined(__INTEL_COMPILER))
 
@@ -224,7 +225,7 @@ inline void *alignedMalloc(size_t size, size_t align)
 
     assert((align & (align - 1)) == 0);
     void *ptr = nullptr;
-    posix_memalign(&ptr, size, align);
+    posix_memalign(&ptr, align, size);
 
     if (size != 0 && ptr == nullptr)
         throw std::bad_alloc();
@@ -337,9 +338,37 @@ inline Vector3 squareToUniformSphere(const Vector2 sample)
     return Vector3(r * cosPhi, r * sinPhi, z);
 }
 
+// wraps a floating point value written to a JSON string: non-finite values
+// are not valid JSON numbers and are written as null
+struct JSONNumber
+{
+    float value;
+};
+
+inline JSONNumber jsonNumber(const float value)
+{
+    return {value};
+}
+
+inline std::ostream &operator<<(std::ostream &os, const JSONNumber &number)
+{
+    if (std::isfinite(number.value))
+        os << number.value;
+    else
+        os << "null";
+    return os;
+}
+
 }  // namespace openpgl
 
 #include <chrono>
+#if defined(__MACOSX__)
+#include <mach/mach.h>
+#include <pthread.h>
+#elif !defined(__WIN32__)
+#include <pthread.h>
+#include <time.h>
+#endif
 namespace openpgl
 {
 class Timer
@@ -369,4 +398,69 @@ class Timer
    private:
     time_point start;
 };
+
+// the CPU time of a thread (in micro seconds), the clock is created on the thread
+// it measures but can be queried from any thread as long as the measured thread exists
+class ThreadCPUClock
+{
+   public:
+    ThreadCPUClock()
+    {
+#if defined(__WIN32__)
+        if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &m_thread, 0, FALSE, DUPLICATE_SAME_ACCESS))
+            m_thread = nullptr;
+#elif defined(__MACOSX__)
+        m_thread = pthread_mach_thread_np(pthread_self());
+#else
+        if (pthread_getcpuclockid(pthread_self(), &m_clock) != 0)
+            m_clock = CLOCK_THREAD_CPUTIME_ID;
+#endif
+    }
+
+    ThreadCPUClock(const ThreadCPUClock &) = delete;
+
+    ~ThreadCPUClock()
+    {
+#if defined(__WIN32__)
+        if (m_thread)
+            CloseHandle(m_thread);
+#endif
+    }
+
+    double now() const
+    {
+#if defined(__WIN32__)
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!m_thread || !GetThreadTimes(m_thread, &creationTime, &exitTime, &kernelTime, &userTime))
+            return 0.0;
+        ULARGE_INTEGER kernel, user;
+        kernel.LowPart = kernelTime.dwLowDateTime;
+        kernel.HighPart = kernelTime.dwHighDateTime;
+        user.LowPart = userTime.dwLowDateTime;
+        user.HighPart = userTime.dwHighDateTime;
+        // FILETIME is measured in 100 nano seconds
+        return double(kernel.QuadPart + user.QuadPart) * 0.1;
+#elif defined(__MACOSX__)
+        thread_basic_info_data_t info;
+        mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+        if (thread_info(m_thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count) != KERN_SUCCESS)
+            return 0.0;
+        return double(info.user_time.seconds + info.system_time.seconds) * 1e6 + double(info.user_time.microseconds + info.system_time.microseconds);
+#else
+        timespec time;
+        if (clock_gettime(m_clock, &time) != 0)
+            return 0.0;
+        return double(time.tv_sec) * 1e6 + double(time.tv_nsec) * 1e-3;
+#endif
+    }
+
+   private:
+#if defined(__WIN32__)
+    HANDLE m_thread;
+#elif defined(__MACOSX__)
+    mach_port_t m_thread;
+#else
+    clockid_t m_clock;
+#endif
+};
 }  // namespace openpgl
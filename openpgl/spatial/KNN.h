@@ -3,28 +3,37 @@
 
 #pragma once
 #include "../openpgl_common.h"
+#include "KNNPointTree.h"
 
 // Nearest neighbor queries
-/* include nanoflann API */
 #include <embreeSrc/common/math/transcendental.h>
 #include <tbb/parallel_for.h>
 
+#include <atomic>
+#include <cstring>
 #include <functional>
-#include <nanoflann/include/nanoflann.hpp>
+#include <limits>
 #include <queue>
+#include <stdexcept>
+#include <vector>
 
+// the default number of closest regions a look-up selects from and of
+// precomputed neighbours per region (see KNearestRegionsSearchTree::setNumNeighbours)
 #define NUM_KNN 4
 #define NUM_KNN_NEIGHBOURS 8
 #define DEBUG_SAMPLE_APPROXIMATE_CLOSEST_REGION_IDX 0
+// compares the neighbours of each incremental update with the ones of a full rebuild
+#define DEBUG_UPDATE_REGION_SEARCH_TREE 0
 
 #define KNN_IS_SIMD
 
 namespace openpgl
 {
 
-inline uint32_t draw(float *sample, uint32_t size)
+// selects one of the k closest of size neighbours
+inline uint32_t draw(float *sample, uint32_t size, const uint32_t k)
 {
-    size = std::min<uint32_t>(NUM_KNN, size);
+    size = std::min<uint32_t>(k, size);
     uint32_t selected = *sample * size;
     *sample = (*sample - float(selected) / size) * size;
     OPENPGL_ASSERT(*sample >= 0.f && *sample < 1.0f);
@@ -32,12 +41,12 @@ inline uint32_t draw(float *sample, uint32_t size)
 }
 
 template <typename RegionNeighbours>
-uint32_t sampleApproximateClosestRegionIdxRef(const RegionNeighbours &nh, const openpgl::Point3 &p, float sample)
+uint32_t sampleApproximateClosestRegionIdxRef(const RegionNeighbours &nh, const openpgl::Point3 &p, float sample, const uint32_t k)
 {
-    uint32_t selected = draw(&sample, nh.size);
+    uint32_t selected = draw(&sample, nh.size, k);
 
     using E = std::pair<uint32_t, float>;
-    E candidates[NUM_KNN_NEIGHBOURS];
+    E candidates[RegionNeighbours::MAX_NEIGHBOURS];
 
     for (int i = 0; i < nh.size; i++)
     {
@@ -46,9 +55,9 @@ uint32_t sampleApproximateClosestRegionIdxRef(const RegionNeighbours &nh, const
         const float xd = std::get<1>(tup) - p.x, yd = std::get<2>(tup) - p.y, zd = std::get<3>(tup) - p.z;
         float d = xd * xd + yd * yd + zd * zd;
 
-        // we use the three least significant bits of the mantissa to store the array ids,
-        // so we have to do the same to get the same results
-        uint32_t mask = (1 << 3) - 1;
+        // we use the three (four for 16 neighbours) least significant bits of the mantissa to
+        // store the array ids, so we have to do the same to get the same results
+        uint32_t mask = RegionNeighbours::MAX_NEIGHBOURS - 1;
         uint32_t *df = (uint32_t *)&d;
         *df = (*df & ~mask) | (i & mask);
 
@@ -68,6 +77,8 @@ struct RegionNeighbours
 template <>
 struct RegionNeighbours<4>
 {
+    static const uint32_t MAX_NEIGHBOURS = 8;
+
     embree::vuint<4> ids[2];
     embree::Vec3<embree::vfloat<4>> points[2];
     uint32_t size;
@@ -100,24 +111,25 @@ struct RegionNeighbours<4>
         return sort_ascending(distances);
     }
 
-    inline uint32_t sampleApproximateClosestRegionIdx(const openpgl::Point3 &p, float *sample) const
+    inline uint32_t sampleApproximateClosestRegionIdx(const openpgl::Point3 &p, float *sample, const uint32_t k) const
     {
-        uint32_t selected = draw(sample, size);
+        uint32_t selected = draw(sample, size, k);
         const embree::Vec3<embree::vfloat<4>> _p(p[0], p[1], p[2]);
 
         const embree::vfloat<4> d0 = prepare(0, _p);
         const embree::vfloat<4> d1 = prepare(1, _p);
 
+        // merges the two sorted halves, for K > 4 one half can run out before the selected entry is reached
         uint32_t i0 = 0, i1 = 0;
         for (uint32_t i = 0; i < selected; i++)
         {
-            if (d0[i0] < d1[i1])
+            if (i1 == 4 || (i0 < 4 && d0[i0] < d1[i1]))
                 i0++;
             else
                 i1++;
         }
 
-        if (d0[i0] < d1[i1])
+        if (i1 == 4 || (i0 < 4 && d0[i0] < d1[i1]))
             return ids[0][asInt(d0)[i0] & 3];
         else
             return ids[1][asInt(d1)[i1] & 3];
@@ -130,30 +142,34 @@ struct RegionNeighbours<4>
         d[0] = this->points[0] - _p;
         d[1] = this->points[1] - _p;
 
+        // unused entries (if less than MAX_NEIGHBOURS neighbours are stored) get a zero weight
+        const embree::vboolf<4> valid[2] = {this->ids[0] != ~0, this->ids[1] != ~0};
         embree::vfloat<4> dist[2];
-        dist[0] = embree::dot(d[0], d[0]);
-        dist[1] = embree::dot(d[1], d[1]);
+        dist[0] = select(valid[0], embree::dot(d[0], d[0]), embree::vfloat<4>(0.f));
+        dist[1] = select(valid[1], embree::dot(d[1], d[1]), embree::vfloat<4>(0.f));
 
         const float maxDist = std::max(embree::reduce_max(dist[0]), embree::reduce_max(dist[1]));
         const float sigma = std::sqrt(maxDist) / 4.0f;
-        dist[0] = embree::fastapprox::exp(-0.5f * dist[0] / (sigma * sigma));
-        dist[1] = embree::fastapprox::exp(-0.5f * dist[1] / (sigma * sigma));
+        dist[0] = select(valid[0], embree::fastapprox::exp(-0.5f * dist[0] / (sigma * sigma)), embree::vfloat<4>(0.f));
+        dist[1] = select(valid[1], embree::fastapprox::exp(-0.5f * dist[1] / (sigma * sigma)), embree::vfloat<4>(0.f));
 #ifdef KNN_IS_SIMD
         embree::vfloat<4> cdfs[2];
         cdfs[0] = vinclusive_prefix_sum(dist[0]);
         cdfs[1] = vinclusive_prefix_sum(dist[1]);
 
-        const float sumDist0 = cdfs[0][3];
-        const float sumDist1 = cdfs[1][3];
+        // the prefix sums of the unused entries can differ from the one of the last used entry by rounding,
+        // the search is therefore restricted to the used entries
+        const float sumDist0 = cdfs[0][std::min(size, 4u) - 1];
+        const float sumDist1 = size > 4 ? cdfs[1][size - 5] : 0.f;
         const float sumDist = sumDist0 + sumDist1;
         float searched = *sample * sumDist;
         size_t idx = 0;
         if (searched > sumDist0)
         {
-            searched -= sumDist0;
+            searched = std::min(searched - sumDist0, sumDist1);
             idx = 1;
         }
-        const size_t sidx = embree::select_min(cdfs[idx] >= searched, cdfs[idx]);
+        const size_t sidx = embree::select_min(valid[idx] & (cdfs[idx] >= searched), cdfs[idx]);
         const float sumCDF = sidx > 0 ? cdfs[idx][sidx - 1] : 0.f;
         *sample = std::min(1 - FLT_EPSILON, (searched - sumCDF) / dist[idx][sidx]);
         return this->ids[idx][sidx];
@@ -196,6 +212,8 @@ struct RegionNeighbours<4>
 template <>
 struct RegionNeighbours<8>
 {
+    static const uint32_t MAX_NEIGHBOURS = 8;
+
     embree::vuint<8> ids;
     embree::Vec3<embree::vfloat<8>> points;
     uint32_t size;
@@ -213,9 +231,9 @@ struct RegionNeighbours<8>
         return {ids[i], points.x[i], points.y[i], points.z[i]};
     }
 
-    inline uint32_t sampleApproximateClosestRegionIdx(const openpgl::Point3 &p, float *sample) const
+    inline uint32_t sampleApproximateClosestRegionIdx(const openpgl::Point3 &p, float *sample, const uint32_t k) const
     {
-        uint32_t selected = draw(sample, size);
+        uint32_t selected = draw(sample, size, k);
 
         const embree::vfloat<8> ids = asFloat(embree::vint<8>(0, 1, 2, 3, 4, 5, 6, 7));
         const embree::vfloat<8> mask = asFloat(embree::vint<8>(~7));
@@ -235,16 +253,20 @@ struct RegionNeighbours<8>
         const embree::Vec3<embree::vfloat<8>> _p(p[0], p[1], p[2]);
         embree::Vec3<embree::vfloat<8>> d;
         d = this->points - _p;
-        embree::vfloat<8> dist = embree::dot(d, d);
+        // unused entries (if less than MAX_NEIGHBOURS neighbours are stored) get a zero weight
+        const embree::vboolf<8> valid = this->ids != ~0;
+        embree::vfloat<8> dist = select(valid, embree::dot(d, d), embree::vfloat<8>(0.f));
         const float maxDist = embree::reduce_max(dist);
         const float sigma = std::sqrt(maxDist) / 4.0f;
-        dist = embree::fastapprox::exp(-0.5f * dist / (sigma * sigma));
+        dist = select(valid, embree::fastapprox::exp(-0.5f * dist / (sigma * sigma)), embree::vfloat<8>(0.f));
 
 #ifdef KNN_IS_SIMD
+        // the prefix sums of the unused entries can differ from the one of the last used entry by rounding,
+        // the search is therefore restricted to the used entries
         const embree::vfloat<8> cdfs = vinclusive_prefix_sum(dist);
-        const float sumDist = cdfs[7];
+        const float sumDist = cdfs[size - 1];
         const float searched = *sample * sumDist;
-        const size_t idx = embree::select_min(cdfs >= searched, cdfs);
+        const size_t idx = embree::select_min(valid & (cdfs >= searched), cdfs);
         const float sumCDF = idx > 0 ? cdfs[idx - 1] : 0.f;
         *sample = std::min(1 - FLT_EPSILON, (searched - sumCDF) / dist[idx]);
         return this->ids[idx];
@@ -275,10 +297,106 @@ struct RegionNeighbours<8>
     }
 };
 
+#if defined(__AVX512F__)
+template <>
+struct RegionNeighbours<16>
+{
+    static const uint32_t MAX_NEIGHBOURS = 16;
+
+    embree::vuint<16> ids;
+    embree::Vec3<embree::vfloat<16>> points;
+    uint32_t size;
+
+    inline void set(uint32_t i, uint32_t id, float x, float y, float z)
+    {
+        ids[i] = id;
+        points.x[i] = x;
+        points.y[i] = y;
+        points.z[i] = z;
+    }
+
+    inline std::tuple<uint32_t, float, float, float> get(uint32_t i) const
+    {
+        return {ids[i], points.x[i], points.y[i], points.z[i]};
+    }
+
+    inline uint32_t sampleApproximateClosestRegionIdx(const openpgl::Point3 &p, float *sample, const uint32_t k) const
+    {
+        uint32_t selected = draw(sample, size, k);
+
+        const embree::vfloat<16> ids = asFloat(embree::vint<16>(embree::step));
+        const embree::vfloat<16> mask = asFloat(embree::vint<16>(~15));
+
+        const embree::Vec3<embree::vfloat<16>> _p(p[0], p[1], p[2]);
+        const embree::Vec3<embree::vfloat<16>> d = points - _p;
+        embree::vfloat<16> distances = embree::dot(d, d);
+        distances = distances & mask | ids;
+
+        // instead of sorting all distances the closest ones are removed until the selected one is the closest,
+        // the array ids stored in the mantissa make the distances unique
+        const embree::vfloat<16> inf(std::numeric_limits<float>::infinity());
+        embree::vboolf<16> valid = this->ids != ~0;
+        for (uint32_t i = 0; i < selected; i++)
+        {
+            valid = valid & (distances != embree::vreduce_min(select(valid, distances, inf)));
+        }
+        return this->ids[embree::select_min(valid, distances)];
+    }
+
+    inline uint32_t sampleApproximateClosestRegionIdxIS(const openpgl::Point3 &p, float *sample) const
+    {
+        const embree::Vec3<embree::vfloat<16>> _p(p[0], p[1], p[2]);
+        embree::Vec3<embree::vfloat<16>> d;
+        d = this->points - _p;
+        // unused entries (if less than MAX_NEIGHBOURS neighbours are stored) get a zero weight
+        const embree::vboolf<16> valid = this->ids != ~0;
+        embree::vfloat<16> dist = select(valid, embree::dot(d, d), embree::vfloat<16>(0.f));
+        const float maxDist = embree::reduce_max(dist);
+        const float sigma = std::sqrt(maxDist) / 4.0f;
+        dist = select(valid, embree::fastapprox::exp(-0.5f * dist / (sigma * sigma)), embree::vfloat<16>(0.f));
+
+#ifdef KNN_IS_SIMD
+        // the prefix sums of the unused entries can differ from the one of the last used entry by rounding,
+        // the search is therefore restricted to the used entries
+        const embree::vfloat<16> cdfs = vinclusive_prefix_sum(dist);
+        const float sumDist = cdfs[size - 1];
+        const float searched = *sample * sumDist;
+        const size_t idx = embree::select_min(valid & (cdfs >= searched), cdfs);
+        const float sumCDF = idx > 0 ? cdfs[idx - 1] : 0.f;
+        *sample = std::min(1 - FLT_EPSILON, (searched - sumCDF) / dist[idx]);
+        return this->ids[idx];
+#else
+        const float sumDist = embree::reduce_add(dist);
+
+        size_t idx = 0;
+        float sumCDF = 0.0f;
+        float searched = *sample * sumDist;
+        float cdf = 0.f;
+        while (true)
+        {
+            cdf = dist[idx];
+            if (sumCDF + cdf >= searched || idx + 1 >= size)
+            {
+                break;
+            }
+            else
+            {
+                sumCDF += cdf;
+                idx++;
+            }
+        }
+
+        *sample = std::min(1 - FLT_EPSILON, (searched - sumCDF) / cdf);
+        return this->ids[idx];
+#endif
+    }
+};
+#else
 template <>
 struct RegionNeighbours<16> : public RegionNeighbours<8>
 {};
 #endif
+#endif
 
 template <int Vecsize>
 struct KNearestRegionsSearchTree
@@ -300,11 +418,17 @@ struct KNearestRegionsSearchTree
         }
     };
 
-    using This = KNearestRegionsSearchTree<Vecsize>;
-    using Index = nanoflann::KDTreeSingleIndexAdaptor<nanoflann::L2_Simple_Adaptor<float, This>, This, 3>;
-    using coord_t = float;
+    using Index = KNNPointTree<Vecsize>;
 
     using RN = RegionNeighbours<Vecsize>;
+    // the 8 entry layout is used for the neighbours if it can hold all of them, on 16-wide
+    // devices this halves the size of the table for the default of 8 neighbours
+    using RNNarrow = RegionNeighbours<(Vecsize > 8 ? 8 : Vecsize)>;
+
+    // written at the start of the serialized search tree ("KNN" followed by the version of its layout),
+    // it has to be changed whenever the layout changes
+    // the first byte differs from the leading bool of the layout used by earlier versions
+    static const uint32_t SERIALIZATION_TAG = 0x024E4E4B;
 
     KNearestRegionsSearchTree() = default;
 
@@ -326,15 +450,17 @@ struct KNearestRegionsSearchTree
         }
         points = (Point *)alignedMalloc(num_points * sizeof(Point), 32);
 
-        for (size_t i = 0; i < num_points; i++)
-        {
-            const auto &region = regionStorage[i].first;
-            const openpgl::SampleStatistics &combinedStats = region.sampleStatistics;
-            const openpgl::Point3 distributionPivot = combinedStats.mean;
-            points[i].p = embree::Vec3f(distributionPivot[0], distributionPivot[1], distributionPivot[2]);
-        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, num_points), [&](tbb::blocked_range<size_t> r) {
+            for (size_t i = r.begin(); i < r.end(); ++i)
+            {
+                const auto &region = regionStorage[i].first;
+                const openpgl::SampleStatistics &combinedStats = region.sampleStatistics;
+                const openpgl::Point3 distributionPivot = combinedStats.mean;
+                points[i].p = embree::Vec3f(distributionPivot[0], distributionPivot[1], distributionPivot[2]);
+            }
+        });
 
-        index = std::unique_ptr<Index>(new Index(3, *this, 10));
+        buildIndex();
 
         _isBuild = true;
         _isBuildNeighbours = false;
@@ -348,48 +474,150 @@ struct KNearestRegionsSearchTree
         {
             alignedFree(neighbours);
         }
-        neighbours = (RN *)alignedMalloc(num_points * sizeof(RN), 32);
+        allocNeighbours();
 
         tbb::parallel_for(tbb::blocked_range<int>(0, num_points), [&](tbb::blocked_range<int> r) {
             for (int n = r.begin(); n < r.end(); ++n)
             {
-                Point &point = points[n];
+                queryRegionNeighbours(n);
+            }
+        });
 
-                const float query_pt[3] = {point.p.x, point.p.y, point.p.z};
+        _isBuildNeighbours = true;
+    }
 
-                size_t num_results = NUM_KNN_NEIGHBOURS;
-                unsigned int ret_index[NUM_KNN_NEIGHBOURS];
-                float ret_dist_sqr[NUM_KNN_NEIGHBOURS];
+    // updates the search tree and the precomputed neighbours after the regions changed (i.e., after an update of the
+    // spatial structure): a region counts as changed if it is new or its mean moved by more than tolerance times the
+    // distance to its closest neighbour, otherwise it keeps its previous position
+    // only the neighbours of the changed regions and of the regions whose neighbours changed are re-queried, for a
+    // tolerance of 0 the result is the same as for a full rebuild, if more than a quarter of the regions changed everything
+    // is rebuilt
+    // note: the regions of the previous build have to keep their indices (i.e., regions are only appended)
+    template <typename TRegionStorageContainer>
+    void updateRegionSearchTree(const TRegionStorageContainer &regionStorage, const float tolerance)
+    {
+        OPENPGL_ASSERT(_isBuild && _isBuildNeighbours);
+        const uint32_t numPrevPoints = num_points;
+        const uint32_t numNewPoints = regionStorage.size();
+        OPENPGL_ASSERT(numNewPoints >= numPrevPoints);
+
+        Point *newPoints = (Point *)alignedMalloc(numNewPoints * sizeof(Point), 32);
+        std::vector<char> changed(numNewPoints, 0);
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, numNewPoints), [&](tbb::blocked_range<uint32_t> r) {
+            for (uint32_t n = r.begin(); n < r.end(); ++n)
+            {
+                const openpgl::Point3 mean = regionStorage[n].first.sampleStatistics.mean;
+                const embree::Vec3fa p = embree::Vec3f(mean[0], mean[1], mean[2]);
+                if (n >= numPrevPoints)
+                {
+                    changed[n] = 1;
+                    newPoints[n].p = p;
+                    continue;
+                }
+                const float movedSqr = embree::sqr_length(p - points[n].p);
+                if (movedSqr > 0.f && movedSqr >= tolerance * tolerance * neighbourDistanceSqr(n, true))
+                {
+                    changed[n] = 1;
+                    newPoints[n].p = p;
+                }
+                else
+                {
+                    newPoints[n] = points[n];
+                }
+            }
+        });
 
-                num_results = index->knnSearch(&query_pt[0], num_results, &ret_index[0], &ret_dist_sqr[0]);
+        std::vector<uint32_t> changedIdxs;
+        for (uint32_t n = 0; n < numNewPoints; n++)
+        {
+            if (changed[n])
+            {
+                changedIdxs.push_back(n);
+            }
+        }
+        if (changedIdxs.empty())
+        {
+            alignedFree(newPoints);
+            return;
+        }
 
-                bool selfIsIn = false;
+        alignedFree(points);
+        points = newPoints;
+        num_points = numNewPoints;
+        buildIndex();
 
-                auto &nh = neighbours[n];
-                nh.size = num_results;
-                int i = 0;
-                for (; i < num_results; i++)
+        if (4 * changedIdxs.size() > numNewPoints)
+        {
+            buildRegionNeighbours();
+            return;
+        }
+
+        // the neighbours of an unchanged region are outdated if one of them changed or if a
+        // changed region moved (or was added) closer than its farthest neighbour
+        Index changedIndex;
+        changedIndex.build(changedIdxs.size(), [&](const uint32_t i) {
+            return points[changedIdxs[i]].p;
+        });
+        std::vector<char> requery(changed);
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, numPrevPoints), [&](tbb::blocked_range<uint32_t> r) {
+            for (uint32_t n = r.begin(); n < r.end(); ++n)
+            {
+                if (changed[n])
                 {
-                    size_t idx = ret_index[i];
-                    selfIsIn = selfIsIn || idx == n;
-                    nh.set(i, idx, points[idx].p.x, points[idx].p.y, points[idx].p.z);
+                    continue;
                 }
-                for (; i < NUM_KNN_NEIGHBOURS; i++)
+                const uint32_t size = getNeighbourCount(n);
+                for (uint32_t i = 0; i < size && !requery[n]; i++)
                 {
-                    nh.set(i, ~0, 0, 0, 0);
+                    requery[n] = changed[std::get<0>(getNeighbour(n, i))];
                 }
+                if (!requery[n])
+                {
+                    const float query_pt[3] = {points[n].p.x, points[n].p.y, points[n].p.z};
+                    unsigned int ret_index;
+                    float ret_dist_sqr;
+                    changedIndex.knnSearch(&query_pt[0], 1, &ret_index, &ret_dist_sqr);
+                    requery[n] = ret_dist_sqr < neighbourDistanceSqr(n, false);
+                }
+            }
+        });
 
-                OPENPGL_ASSERT(selfIsIn);
-#ifdef OPENPGL_SHOW_PRINT_OUTS
-                if (!selfIsIn)
+        char *prevNeighbours = neighbours;
+        allocNeighbours();
+        std::memcpy(neighbours, prevNeighbours, numPrevPoints * getNeighboursStride());
+        alignedFree(prevNeighbours);
+
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, numNewPoints), [&](tbb::blocked_range<uint32_t> r) {
+            for (uint32_t n = r.begin(); n < r.end(); ++n)
+            {
+                if (requery[n])
                 {
-                    std::cout << "No closest region found" << std::endl;
+                    queryRegionNeighbours(n);
                 }
-#endif
             }
         });
 
-        _isBuildNeighbours = true;
+#if DEBUG_UPDATE_REGION_SEARCH_TREE
+        // the incremental update has to give the same neighbours as a full rebuild, a mismatch
+        // usually means that the regions of the previous build did not keep their indices
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, numNewPoints), [&](tbb::blocked_range<uint32_t> r) {
+            for (uint32_t n = r.begin(); n < r.end(); ++n)
+            {
+                RN ref;
+                queryRegionNeighbours(n, ref);
+                OPENPGL_ASSERT(ref.size == getNeighbourCount(n));
+                for (uint32_t i = 0; i < ref.size; i++)
+                {
+                    bool found = false;
+                    for (uint32_t j = 0; j < ref.size && !found; j++)
+                    {
+                        found = std::get<0>(ref.get(i)) == std::get<0>(getNeighbour(n, j));
+                    }
+                    OPENPGL_ASSERT(found);
+                }
+            }
+        });
+#endif
     }
 
     uint32_t sampleClosestRegionIdx(const openpgl::Point3 &p, float *sample) const
@@ -398,11 +626,11 @@ struct KNearestRegionsSearchTree
 
         const float query_pt[3] = {p.x, p.y, p.z};
 
-        size_t num_results = NUM_KNN;
-        unsigned int ret_index[NUM_KNN];
-        float ret_dist_sqr[NUM_KNN];
+        size_t num_results = k;
+        unsigned int ret_index[RN::MAX_NEIGHBOURS];
+        float ret_dist_sqr[RN::MAX_NEIGHBOURS];
 
-        num_results = index->knnSearch(&query_pt[0], num_results, &ret_index[0], &ret_dist_sqr[0]);
+        num_results = index.knnSearch(&query_pt[0], num_results, &ret_index[0], &ret_dist_sqr[0]);
 
         if (num_results == 0)
         {
@@ -412,7 +640,7 @@ struct KNearestRegionsSearchTree
             return -1;
         }
 
-        return ret_index[draw(sample, num_results)];
+        return ret_index[draw(sample, num_results, k)];
     }
 
     uint32_t sampleApproximateClosestRegionIdx(unsigned int regionIdx, const openpgl::Point3 &p, float *sample) const
@@ -420,9 +648,11 @@ struct KNearestRegionsSearchTree
         OPENPGL_ASSERT(_isBuildNeighbours);
 
 #if DEBUG_SAMPLE_APPROXIMATE_CLOSEST_REGION_IDX
-        uint32_t ref = sampleApproximateClosestRegionIdxRef(neighbours[regionIdx], p, *sample);
+        uint32_t ref = narrowNeighbours ? sampleApproximateClosestRegionIdxRef(getNeighbours<RNNarrow>(regionIdx), p, *sample, k)
+                                        : sampleApproximateClosestRegionIdxRef(getNeighbours<RN>(regionIdx), p, *sample, k);
 #endif
-        uint32_t out = neighbours[regionIdx].sampleApproximateClosestRegionIdx(p, sample);
+        uint32_t out = narrowNeighbours ? getNeighbours<RNNarrow>(regionIdx).sampleApproximateClosestRegionIdx(p, sample, k)
+                                        : getNeighbours<RN>(regionIdx).sampleApproximateClosestRegionIdx(p, sample, k);
 #if DEBUG_SAMPLE_APPROXIMATE_CLOSEST_REGION_IDX
         OPENPGL_ASSERT(ref == out);
 #endif
@@ -433,7 +663,8 @@ struct KNearestRegionsSearchTree
     uint32_t sampleApproximateClosestRegionIdxIS(unsigned int regionIdx, const openpgl::Point3 &p, float *sample) const
     {
         OPENPGL_ASSERT(_isBuildNeighbours);
-        uint32_t out = neighbours[regionIdx].sampleApproximateClosestRegionIdxIS(p, sample);
+        uint32_t out = narrowNeighbours ? getNeighbours<RNNarrow>(regionIdx).sampleApproximateClosestRegionIdxIS(p, sample)
+                                        : getNeighbours<RN>(regionIdx).sampleApproximateClosestRegionIdxIS(p, sample);
         return out;
     }
 
@@ -452,15 +683,69 @@ struct KNearestRegionsSearchTree
         return num_points;
     }
 
+    // size in bytes of the points, the search index and the precomputed neighbours of the regions
+    size_t getMemoryUsage() const
+    {
+        size_t memoryUsage = num_points * sizeof(Point) + index.getMemoryUsage();
+        if (neighbours)
+        {
+            memoryUsage += num_points * getNeighboursStride();
+        }
+        return memoryUsage;
+    }
+
+    // sets the number of neighbours precomputed for each region (at most RN::MAX_NEIGHBOURS) and the
+    // number of closest regions a look-up randomly selects from (k <= numNeighbours),
+    // needs to be set before the neighbours are built
+    void setNumNeighbours(const uint32_t numNeighbours, const uint32_t k)
+    {
+        const uint32_t maxNeighbours = RN::MAX_NEIGHBOURS;
+        this->numNeighbours = std::max(1u, std::min(numNeighbours, maxNeighbours));
+        this->k = std::max(1u, std::min(k, this->numNeighbours));
+    }
+
+    uint32_t getNumNeighbours() const
+    {
+        return numNeighbours;
+    }
+
+    uint32_t getK() const
+    {
+        return k;
+    }
+
+    // the precomputed neighbours are stored as region indices (i.e., independent of the SIMD width),
+    // their positions are restored from the points when the search tree is loaded
     void serialize(std::ostream &stream) const
     {
+        const uint32_t serializationTag = SERIALIZATION_TAG;
+        stream.write(reinterpret_cast<const char *>(&serializationTag), sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(&numNeighbours), sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(&k), sizeof(uint32_t));
         stream.write(reinterpret_cast<const char *>(&_isBuild), sizeof(bool));
         if (_isBuild)
         {
             stream.write(reinterpret_cast<const char *>(&num_points), sizeof(uint32_t));
-            for (uint32_t n = 0; n < num_points; n++)
+            stream.write(reinterpret_cast<const char *>(points), num_points * sizeof(Point));
+
+            stream.write(reinterpret_cast<const char *>(&_isBuildNeighbours), sizeof(bool));
+            if (_isBuildNeighbours)
             {
-                stream.write(reinterpret_cast<const char *>(&points[n]), sizeof(Point));
+                // per region: the number of neighbours followed by numNeighbours indices
+                const uint32_t stride = numNeighbours + 1;
+                std::vector<uint32_t> serializedNeighbours(size_t(num_points) * stride);
+                tbb::parallel_for(tbb::blocked_range<uint32_t>(0, num_points), [&](tbb::blocked_range<uint32_t> r) {
+                    for (uint32_t n = r.begin(); n < r.end(); ++n)
+                    {
+                        uint32_t *serialized = &serializedNeighbours[size_t(n) * stride];
+                        serialized[0] = getNeighbourCount(n);
+                        for (uint32_t i = 0; i < numNeighbours; i++)
+                        {
+                            serialized[i + 1] = std::get<0>(getNeighbour(n, i));
+                        }
+                    }
+                });
+                stream.write(reinterpret_cast<const char *>(serializedNeighbours.data()), serializedNeighbours.size() * sizeof(uint32_t));
             }
         }
     }
@@ -479,26 +764,128 @@ struct KNearestRegionsSearchTree
             alignedFree(neighbours);
             neighbours = nullptr;
         }
+        index.clear();
 
         _isBuildNeighbours = false;
         _isBuild = false;
     }
 
+    // if the precomputed neighbours are stored they are restored directly and the search index,
+    // which is only needed to (re-)compute them, is not built
+    // if more neighbours are stored than RN::MAX_NEIGHBOURS (i.e., for a smaller SIMD width) only
+    // the closest ones are kept
+    // field files written with a different layout of the search tree are rejected (independent of
+    // OPENPGL_STRICT_IO_VERSION_CHECKING) and the stored neighbour indices are checked against the
+    // number of stored points
     void deserialize(std::istream &stream)
     {
+        reset();
+        uint32_t serializationTag = 0;
+        stream.read(reinterpret_cast<char *>(&serializationTag), sizeof(uint32_t));
+        if (!stream || serializationTag != SERIALIZATION_TAG)
+        {
+            throw std::runtime_error("error: unsupported format of the KNN search tree in the field file (the file was written by an incompatible version of Open PGL)");
+        }
+        uint32_t storedNumNeighbours, storedK;
+        stream.read(reinterpret_cast<char *>(&storedNumNeighbours), sizeof(uint32_t));
+        stream.read(reinterpret_cast<char *>(&storedK), sizeof(uint32_t));
+        if (!stream || storedNumNeighbours == 0 || storedNumNeighbours > Index::MAX_K)
+        {
+            throw std::runtime_error("error: invalid KNN search tree in the field file");
+        }
+        setNumNeighbours(storedNumNeighbours, storedK);
         stream.read(reinterpret_cast<char *>(&_isBuild), sizeof(bool));
         if (_isBuild)
         {
             stream.read(reinterpret_cast<char *>(&num_points), sizeof(uint32_t));
+            if (!stream)
+            {
+                reset();
+                throw std::runtime_error("error: invalid KNN search tree in the field file");
+            }
             points = (Point *)alignedMalloc(num_points * sizeof(Point), 32);
-            for (uint32_t n = 0; n < num_points; n++)
+            stream.read(reinterpret_cast<char *>(points), num_points * sizeof(Point));
+
+            stream.read(reinterpret_cast<char *>(&_isBuildNeighbours), sizeof(bool));
+            if (!stream)
+            {
+                reset();
+                throw std::runtime_error("error: invalid KNN search tree in the field file");
+            }
+            if (_isBuildNeighbours)
+            {
+                const uint32_t stride = storedNumNeighbours + 1;
+                std::vector<uint32_t> serializedNeighbours(size_t(num_points) * stride);
+                stream.read(reinterpret_cast<char *>(serializedNeighbours.data()), serializedNeighbours.size() * sizeof(uint32_t));
+                allocNeighbours();
+                const uint32_t maxNeighbours = narrowNeighbours ? RNNarrow::MAX_NEIGHBOURS : RN::MAX_NEIGHBOURS;
+                std::atomic<bool> invalid{!stream};
+                tbb::parallel_for(tbb::blocked_range<uint32_t>(0, num_points), [&](tbb::blocked_range<uint32_t> r) {
+                    for (uint32_t n = r.begin(); n < r.end() && !invalid; ++n)
+                    {
+                        const uint32_t *serialized = &serializedNeighbours[size_t(n) * stride];
+                        if (serialized[0] > storedNumNeighbours)
+                        {
+                            invalid = true;
+                            break;
+                        }
+                        const uint32_t size = std::min(serialized[0], numNeighbours);
+                        setNeighbourCount(n, size);
+                        for (uint32_t i = 0; i < maxNeighbours; i++)
+                        {
+                            if (i < size && serialized[i + 1] < num_points)
+                            {
+                                const uint32_t idx = serialized[i + 1];
+                                setNeighbour(n, i, idx, points[idx].p.x, points[idx].p.y, points[idx].p.z);
+                            }
+                            else
+                            {
+                                if (i < size)
+                                {
+                                    invalid = true;
+                                }
+                                setNeighbour(n, i, ~0, 0, 0, 0);
+                            }
+                        }
+                    }
+                });
+                if (invalid)
+                {
+                    reset();
+                    throw std::runtime_error("error: invalid KNN search tree in the field file");
+                }
+            }
+            else
             {
-                Point p;
-                stream.read(reinterpret_cast<char *>(&p), sizeof(Point));
-                points[n] = p;
+                buildIndex();
             }
+        }
+    }
 
-            index = std::unique_ptr<Index>(new Index(3, *this, 10));
+    // deep copies the points and the precomputed neighbours from another search tree,
+    // the search index is rebuilt from the copied points
+    void copyFrom(const KNearestRegionsSearchTree &b)
+    {
+        reset();
+        numNeighbours = b.numNeighbours;
+        k = b.k;
+        if (!b._isBuild)
+        {
+            return;
+        }
+
+        num_points = b.num_points;
+        points = (Point *)alignedMalloc(num_points * sizeof(Point), 32);
+        std::copy(b.points, b.points + num_points, points);
+        buildIndex();
+        _isBuild = true;
+
+        if (b._isBuildNeighbours)
+        {
+            allocNeighbours();
+            OPENPGL_ASSERT(narrowNeighbours == b.narrowNeighbours);
+            std::memcpy(neighbours, b.neighbours, num_points * getNeighboursStride());
+            _isBuildNeighbours = true;
         }
     }
 
@@ -511,30 +898,150 @@ struct KNearestRegionsSearchTree
         return ss.str();
     }
 
-    // Must return the number of data points
-    inline size_t kdtree_get_point_count() const
+   private:
+    void buildIndex()
     {
-        return num_points;
+        index.build(num_points, [&](const uint32_t i) {
+            return points[i].p;
+        });
+    }
+
+    // (re-)computes the precomputed neighbours of region n
+    void queryRegionNeighbours(const uint32_t n)
+    {
+        if (narrowNeighbours)
+        {
+            queryRegionNeighbours(n, getNeighbours<RNNarrow>(n));
+        }
+        else
+        {
+            queryRegionNeighbours(n, getNeighbours<RN>(n));
+        }
+    }
+
+    template <typename TRN>
+    void queryRegionNeighbours(const uint32_t n, TRN &nh) const
+    {
+        Point &point = points[n];
+
+        const float query_pt[3] = {point.p.x, point.p.y, point.p.z};
+
+        size_t num_results = numNeighbours;
+        unsigned int ret_index[RN::MAX_NEIGHBOURS];
+        float ret_dist_sqr[RN::MAX_NEIGHBOURS];
+
+        num_results = index.knnSearch(&query_pt[0], num_results, &ret_index[0], &ret_dist_sqr[0]);
+
+        bool selfIsIn = false;
+
+        nh.size = num_results;
+        int i = 0;
+        for (; i < num_results; i++)
+        {
+            size_t idx = ret_index[i];
+            selfIsIn = selfIsIn || idx == n;
+            nh.set(i, idx, points[idx].p.x, points[idx].p.y, points[idx].p.z);
+        }
+        for (; i < TRN::MAX_NEIGHBOURS; i++)
+        {
+            nh.set(i, ~0, 0, 0, 0);
+        }
+
+        OPENPGL_ASSERT(selfIsIn);
+#ifdef OPENPGL_SHOW_PRINT_OUTS
+        if (!selfIsIn)
+        {
+            std::cout << "No closest region found" << std::endl;
+        }
+#endif
     }
 
-    inline coord_t kdtree_get_pt(const size_t idx, const size_t dim) const
+    // the squared distance between region n and the closest other (closest = true) or the farthest of
+    // its precomputed neighbours, if less than numNeighbours neighbours exist the farthest one is at infinity
+    float neighbourDistanceSqr(const uint32_t n, const bool closest) const
     {
-        return points[idx].p[dim];
+        const uint32_t size = getNeighbourCount(n);
+        if (!closest && size < numNeighbours)
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+        float distSqr = closest ? std::numeric_limits<float>::infinity() : 0.f;
+        for (uint32_t i = 0; i < size; i++)
+        {
+            const auto tup = getNeighbour(n, i);
+            if (std::get<0>(tup) != n)
+            {
+                const embree::Vec3fa d = embree::Vec3fa(std::get<1>(tup), std::get<2>(tup), std::get<3>(tup)) - points[n].p;
+                distSqr = closest ? std::min(distSqr, embree::sqr_length(d)) : std::max(distSqr, embree::sqr_length(d));
+            }
+        }
+        return distSqr;
     }
 
-    template <class BBOX>
-    bool kdtree_get_bbox(BBOX & /*bb*/) const
+    // allocates the table of the precomputed neighbours for num_points regions
+    // in the layout selected by the number of neighbours
+    void allocNeighbours()
     {
-        return false;
+        narrowNeighbours = sizeof(RNNarrow) < sizeof(RN) && numNeighbours <= RNNarrow::MAX_NEIGHBOURS;
+        neighbours = (char *)alignedMalloc(num_points * getNeighboursStride(), 64);
+    }
+
+    size_t getNeighboursStride() const
+    {
+        return narrowNeighbours ? sizeof(RNNarrow) : sizeof(RN);
+    }
+
+    template <typename TRN>
+    TRN &getNeighbours(const uint32_t n) const
+    {
+        return reinterpret_cast<TRN *>(neighbours)[n];
+    }
+
+    uint32_t getNeighbourCount(const uint32_t n) const
+    {
+        return narrowNeighbours ? getNeighbours<RNNarrow>(n).size : getNeighbours<RN>(n).size;
+    }
+
+    std::tuple<uint32_t, float, float, float> getNeighbour(const uint32_t n, const uint32_t i) const
+    {
+        return narrowNeighbours ? getNeighbours<RNNarrow>(n).get(i) : getNeighbours<RN>(n).get(i);
+    }
+
+    void setNeighbourCount(const uint32_t n, const uint32_t size)
+    {
+        if (narrowNeighbours)
+        {
+            getNeighbours<RNNarrow>(n).size = size;
+        }
+        else
+        {
+            getNeighbours<RN>(n).size = size;
+        }
+    }
+
+    void setNeighbour(const uint32_t n, const uint32_t i, const uint32_t id, const float x, const float y, const float z)
+    {
+        if (narrowNeighbours)
+        {
+            getNeighbours<RNNarrow>(n).set(i, id, x, y, z);
+        }
+        else
+        {
+            getNeighbours<RN>(n).set(i, id, x, y, z);
+        }
     }
 
-   private:
     Point *points = nullptr;
     uint32_t num_points{0};
 
-    std::unique_ptr<Index> index;
+    Index index;
 
-    RN *neighbours = nullptr;
+    // the precomputed neighbours of the regions, stored as RNNarrow if narrowNeighbours is set and as RN otherwise
+    char *neighbours = nullptr;
+    bool narrowNeighbours{false};
+    // the number of precomputed neighbours per region and the number of closest ones a look-up selects from
+    uint32_t numNeighbours{NUM_KNN_NEIGHBOURS};
+    uint32_t k{NUM_KNN};
 
     bool _isBuild{false};
     bool _isBuildNeighbours{false};
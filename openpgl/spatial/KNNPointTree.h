@@ -0,0 +1,305 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "../openpgl_common.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_reduce.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace openpgl
+{
+
+// KD-tree over a static set of points (i.e., the means of the regions) for K-nearest neighbour queries
+// the tree is built in parallel by recursively splitting the points at their median along the
+// dimension of their largest extent, each leaf stores up to LEAF_SIZE points in SoA layout
+// so that the distances to all points of a leaf are calculated using a few SIMD instructions
+template <int Vecsize>
+struct KNNPointTree
+{
+    static const uint32_t LEAF_SIZE = 8;
+    static const uint32_t MAX_K = 16;
+    static const uint32_t SIMD_WIDTH = Vecsize < 8 ? Vecsize : 8;
+    static const uint32_t NUM_LEAF_BLOCKS = LEAF_SIZE / SIMD_WIDTH;
+    // subtrees with fewer points are built serially
+    static const uint32_t PARALLEL_BUILD_THRESHOLD = 4096;
+
+    using vfloat = embree::vfloat<SIMD_WIDTH>;
+    using vuint = embree::vuint<SIMD_WIDTH>;
+
+    KNNPointTree() = default;
+
+    KNNPointTree(const KNNPointTree &) = delete;
+
+    ~KNNPointTree()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        alignedFree(nodes);
+        alignedFree(leaves);
+        nodes = nullptr;
+        leaves = nullptr;
+        numPoints = 0;
+    }
+
+    // size in bytes of the nodes and leaves allocated by build
+    size_t getMemoryUsage() const
+    {
+        const size_t maxNumLeaves = numPoints > 0 ? numPoints / (LEAF_SIZE / 2) + 1 : 0;
+        return 2 * maxNumLeaves * sizeof(Node) + maxNumLeaves * sizeof(Leaf);
+    }
+
+    // builds the tree over numPoints points, point(i) returns the position of the i-th
+    // point as embree::Vec3fa and i is the index returned by knnSearch
+    template <typename TPointAccessor>
+    void build(const uint32_t numPoints, const TPointAccessor &point)
+    {
+        clear();
+        this->numPoints = numPoints;
+        if (numPoints == 0)
+        {
+            return;
+        }
+
+        BuildPoint *buildPoints = (BuildPoint *)alignedMalloc(numPoints * sizeof(BuildPoint), 32);
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, numPoints), [&](tbb::blocked_range<uint32_t> r) {
+            for (uint32_t i = r.begin(); i < r.end(); ++i)
+            {
+                const embree::Vec3fa p = point(i);
+                buildPoints[i] = {{p.x, p.y, p.z}, i};
+            }
+        });
+
+        // each split halves the points, leaves therefore contain more than LEAF_SIZE / 2 points
+        const uint32_t maxNumLeaves = numPoints / (LEAF_SIZE / 2) + 1;
+        nodes = (Node *)alignedMalloc(2 * maxNumLeaves * sizeof(Node), 32);
+        leaves = (Leaf *)alignedMalloc(maxNumLeaves * sizeof(Leaf), 32);
+        std::atomic<uint32_t> numNodes{1};
+        std::atomic<uint32_t> numLeaves{0};
+        buildNode(0, buildPoints, 0, numPoints, numNodes, numLeaves);
+        OPENPGL_ASSERT(numLeaves <= maxNumLeaves);
+
+        alignedFree(buildPoints);
+    }
+
+    // searches the (up to) k <= MAX_K closest points to query, their indices and squared distances
+    // are returned sorted by increasing distance (points with the same distance by their index,
+    // equidistant points in different subtrees are resolved by the traversal order)
+    size_t knnSearch(const float *query, const size_t k, unsigned int *indices, float *distsSqr) const
+    {
+        OPENPGL_ASSERT(k <= MAX_K);
+        ResultSet result(k);
+        if (numPoints > 0 && k > 0)
+        {
+            float dists[3] = {0.f, 0.f, 0.f};
+            searchNode(0, query, 0.f, dists, result);
+        }
+        for (uint32_t i = 0; i < result.count; i++)
+        {
+            indices[i] = result.ids[i];
+            distsSqr[i] = result.distsSqr[i];
+        }
+        return result.count;
+    }
+
+    uint32_t size() const
+    {
+        return numPoints;
+    }
+
+   private:
+    struct BuildPoint
+    {
+        float p[3];
+        uint32_t id;
+    };
+
+    struct Node
+    {
+        // the split position (for inner nodes)
+        float split;
+        // the split dimension (3 for leaves) in the lowest two bits and the
+        // index of the left child (the right child follows it) or of the leaf
+        uint32_t dimAndIdx;
+
+        inline bool isLeaf() const
+        {
+            return (dimAndIdx & 3) == 3;
+        }
+
+        inline uint32_t getDim() const
+        {
+            return dimAndIdx & 3;
+        }
+
+        inline uint32_t getIdx() const
+        {
+            return dimAndIdx >> 2;
+        }
+    };
+
+    struct Leaf
+    {
+        embree::Vec3<vfloat> points[NUM_LEAF_BLOCKS];
+        vuint ids[NUM_LEAF_BLOCKS];
+    };
+
+    // sorted list of the k closest points found so far
+    struct ResultSet
+    {
+        ResultSet(const size_t k) : k(k) {}
+
+        inline float worstDistSqr() const
+        {
+            return count < k ? std::numeric_limits<float>::infinity() : distsSqr[k - 1];
+        }
+
+        inline void add(const float distSqr, const uint32_t id)
+        {
+            if (count == k && (distSqr > distsSqr[k - 1] || (distSqr == distsSqr[k - 1] && id > ids[k - 1])))
+            {
+                return;
+            }
+            uint32_t i = count < k ? count++ : k - 1;
+            for (; i > 0 && (distsSqr[i - 1] > distSqr || (distsSqr[i - 1] == distSqr && ids[i - 1] > id)); i--)
+            {
+                distsSqr[i] = distsSqr[i - 1];
+                ids[i] = ids[i - 1];
+            }
+            distsSqr[i] = distSqr;
+            ids[i] = id;
+        }
+
+        const uint32_t k;
+        uint32_t count{0};
+        float distsSqr[MAX_K];
+        uint32_t ids[MAX_K];
+    };
+
+    void buildNode(const uint32_t nodeIdx, BuildPoint *buildPoints, const uint32_t begin, const uint32_t end, std::atomic<uint32_t> &numNodes,
+                   std::atomic<uint32_t> &numLeaves)
+    {
+        const uint32_t num = end - begin;
+        if (num <= LEAF_SIZE)
+        {
+            const uint32_t leafIdx = numLeaves++;
+            Leaf &leaf = leaves[leafIdx];
+            // unused slots are set to NaN, their distances are never smaller than the current worst distance
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            for (uint32_t i = 0; i < LEAF_SIZE; i++)
+            {
+                const BuildPoint *p = i < num ? &buildPoints[begin + i] : nullptr;
+                embree::Vec3<vfloat> &block = leaf.points[i / SIMD_WIDTH];
+                block.x[i % SIMD_WIDTH] = p ? p->p[0] : nan;
+                block.y[i % SIMD_WIDTH] = p ? p->p[1] : nan;
+                block.z[i % SIMD_WIDTH] = p ? p->p[2] : nan;
+                leaf.ids[i / SIMD_WIDTH][i % SIMD_WIDTH] = p ? p->id : ~0u;
+            }
+            nodes[nodeIdx].split = 0.f;
+            nodes[nodeIdx].dimAndIdx = (leafIdx << 2) | 3;
+            return;
+        }
+
+        const BBox bounds = computeBounds(buildPoints, begin, end);
+        const uint32_t dim = embree::maxDim(bounds.size());
+        const uint32_t mid = begin + num / 2;
+        std::nth_element(buildPoints + begin, buildPoints + mid, buildPoints + end, [dim](const BuildPoint &a, const BuildPoint &b) {
+            return a.p[dim] < b.p[dim] || (a.p[dim] == b.p[dim] && a.id < b.id);
+        });
+
+        const uint32_t childIdx = numNodes.fetch_add(2);
+        nodes[nodeIdx].split = buildPoints[mid].p[dim];
+        nodes[nodeIdx].dimAndIdx = (childIdx << 2) | dim;
+        if (num > PARALLEL_BUILD_THRESHOLD)
+        {
+            tbb::parallel_invoke([&]() { buildNode(childIdx, buildPoints, begin, mid, numNodes, numLeaves); },
+                                 [&]() { buildNode(childIdx + 1, buildPoints, mid, end, numNodes, numLeaves); });
+        }
+        else
+        {
+            buildNode(childIdx, buildPoints, begin, mid, numNodes, numLeaves);
+            buildNode(childIdx + 1, buildPoints, mid, end, numNodes, numLeaves);
+        }
+    }
+
+    static BBox computeBounds(const BuildPoint *buildPoints, const uint32_t begin, const uint32_t end)
+    {
+        auto extend = [buildPoints](const tbb::blocked_range<uint32_t> &r, BBox bounds) {
+            for (uint32_t i = r.begin(); i < r.end(); ++i)
+            {
+                bounds.extend(Vector3(buildPoints[i].p[0], buildPoints[i].p[1], buildPoints[i].p[2]));
+            }
+            return bounds;
+        };
+        if (end - begin <= PARALLEL_BUILD_THRESHOLD)
+        {
+            return extend(tbb::blocked_range<uint32_t>(begin, end), BBox(embree::empty));
+        }
+        return tbb::parallel_reduce(tbb::blocked_range<uint32_t>(begin, end, PARALLEL_BUILD_THRESHOLD), BBox(embree::empty), extend,
+                                    [](const BBox &a, const BBox &b) {
+                                        return embree::merge(a, b);
+                                    });
+    }
+
+    // visits the child on the side of the query first, the other child is only visited if it can contain
+    // closer points than the current worst one: minDistSqr is the squared distance between the query and
+    // the cell of the node and dists holds its per-dimension components (see Arya and Mount, "Algorithms for
+    // fast vector quantization")
+    void searchNode(const uint32_t nodeIdx, const float *query, float minDistSqr, float *dists, ResultSet &result) const
+    {
+        const Node &node = nodes[nodeIdx];
+        if (node.isLeaf())
+        {
+            searchLeaf(leaves[node.getIdx()], query, result);
+            return;
+        }
+
+        const uint32_t dim = node.getDim();
+        const float diff = query[dim] - node.split;
+        const uint32_t nearIdx = node.getIdx() + (diff < 0.f ? 0 : 1);
+        const uint32_t farIdx = node.getIdx() + (diff < 0.f ? 1 : 0);
+        searchNode(nearIdx, query, minDistSqr, dists, result);
+
+        const float cutDist = diff * diff;
+        const float prevDist = dists[dim];
+        minDistSqr = minDistSqr + cutDist - prevDist;
+        if (minDistSqr < result.worstDistSqr())
+        {
+            dists[dim] = cutDist;
+            searchNode(farIdx, query, minDistSqr, dists, result);
+            dists[dim] = prevDist;
+        }
+    }
+
+    inline void searchLeaf(const Leaf &leaf, const float *query, ResultSet &result) const
+    {
+        const embree::Vec3<vfloat> q(query[0], query[1], query[2]);
+        for (uint32_t b = 0; b < NUM_LEAF_BLOCKS; b++)
+        {
+            const embree::Vec3<vfloat> d = q - leaf.points[b];
+            const vfloat distsSqr = d.x * d.x + d.y * d.y + d.z * d.z;
+            size_t mask = embree::movemask(distsSqr <= vfloat(result.worstDistSqr()));
+            while (mask)
+            {
+                const size_t i = embree::bscf(mask);
+                result.add(distsSqr[i], leaf.ids[b][i]);
+            }
+        }
+    }
+
+    uint32_t numPoints{0};
+    Node *nodes{nullptr};
+    Leaf *leaves{nullptr};
+};
+
+}  // namespace openpgl
@@ -4,10 +4,15 @@
 #pragma once
 
 #include <tbb/concurrent_vector.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <string>
+#include <vector>
 
 #include "../../openpgl_common.h"
 #include "KDTreeStatistics.h"
@@ -182,8 +187,66 @@ struct KDTreeLet
     KDNode nodes[8];
 };
 
+// node of the wide KD-tree which collapses the split planes of multiple levels of the
+// binary tree (3 planes/4 children for a 4-wide tree, 7 planes/8 children for an 8-wide tree),
+// the planes are stored in heap order (0: root, 1-2: second level, 3-6: third level)
+struct KDWideNode
+{
+    enum
+    {
+        ELeafFlag = 1U << 31
+    };
+
+    float splitPivots[8];
+    int splitDims[8];
+    // index of the child node or the data index of the leaf (ELeafFlag set)
+    uint32_t children[8];
+};
+
+// stores the path of the previous look-up through a KDTree (see KDTree::getDataIdxAtPos(pos, cache)),
+// coherent look-ups which end in the same leaf only need to test the bounds of the leaf, the others
+// restart the traversal from the deepest node on the path which still contains the position
+struct KDTreeLookUpCache
+{
+    static const uint32_t MAX_PATH_LENGTH = 64;
+
+    // the number of valid entries of path/pathBounds (0 = empty), the last entry is the leaf
+    uint32_t pathLength{0};
+    uint32_t dataIdx{0};
+    uint32_t path[MAX_PATH_LENGTH];
+    BBox pathBounds[MAX_PATH_LENGTH];
+
+    // only written by the thread owning the cache but read by others (see Field::getStatistics),
+    // the relaxed atomics are updated with plain loads and stores instead of locked increments
+    std::atomic<size_t> numLookUps{0};
+    std::atomic<size_t> numHits{0};
+
+    void reset()
+    {
+        pathLength = 0;
+        numLookUps.store(0, std::memory_order_relaxed);
+        numHits.store(0, std::memory_order_relaxed);
+    }
+
+    // the bounds of the nodes are half-open (i.e., split planes belong to the right child) to
+    // match the traversal, positions on the upper bounds of the tree are therefore never contained
+    inline bool contains(const uint32_t pathIdx, const Vector3 &pos) const
+    {
+        const BBox &bounds = pathBounds[pathIdx];
+        return pos.x >= bounds.lower.x && pos.y >= bounds.lower.y && pos.z >= bounds.lower.z && pos.x < bounds.upper.x && pos.y < bounds.upper.y &&
+               pos.z < bounds.upper.z;
+    }
+};
+
 struct KDTree
 {
+    enum
+    {
+        EGridLeafFlag = 1U << 31
+    };
+
+    typedef KDTreeLookUpCache LookUpCache;
+
     KDTree() = default;
 
     KDTree(const KDTree &) = delete;
@@ -192,13 +255,6 @@ struct KDTree
     {
         if (m_nodesPtr)
             delete[] m_nodesPtr;
-
-        if (m_treeLets)
-        {
-            delete[] m_treeLets;
-            m_treeLets = nullptr;
-            m_numTreeLets = 0;
-        }
     }
 
     inline void init(const BBox &bounds, size_t numNodesReseve = 0)
@@ -259,6 +315,16 @@ struct KDTree
         return m_bounds;
     }
 
+    // size in bytes of the (used) nodes and the (optional) acceleration structures used for querying
+    size_t getMemoryUsage() const
+    {
+        size_t memoryUsage = m_nodes.size() * sizeof(KDNode) + m_numNodesPtr * sizeof(KDNode);
+        memoryUsage += m_treeLets.size() * sizeof(KDTreeLet) + m_treeLetSlots.size() * sizeof(uint32_t);
+        memoryUsage += m_wideNodes.size() * sizeof(KDWideNode);
+        memoryUsage += m_gridCells.size() * sizeof(uint32_t);
+        return memoryUsage;
+    }
+
     void rearrangeNodeForCompare(const KDNode &node, int idx, std::vector<KDNode> &newNodes, std::vector<uint32_t> &dataStorageIndices) const
     {
         if (!node.isLeaf())
@@ -292,60 +358,138 @@ struct KDTree
         }
     }
 
+    // removes all nodes which are not reachable from the root anymore (e.g., after collapsing
+    // inner nodes into leaves) and renumbers the data indices of the leaves in depth-first order,
+    // dataIdxs returns the previous data index of each leaf
+    void compact(std::vector<uint32_t> &dataIdxs)
+    {
+        std::vector<KDNode> nodes;
+        dataIdxs.clear();
+        rearrangeNodesForCompare(nodes, dataIdxs);
+        tbb::concurrent_vector<KDNode>(nodes.begin(), nodes.end()).swap(m_nodes);
+    }
+
+    // updates the node array and the treelets used for querying after the tree was build or updated,
+    // if the tree only grew by splitting leaves since the last call (e.g., by KDTreePartitionBuilder::updateTree)
+    // only the new subtrees are inserted into the existing treelets, otherwise the treelets are rebuilt
     void finalize()
     {
-        if (m_nodesPtr)
+        const size_t nNodes = m_nodes.size();
+        if (nNodes == 0)
         {
-            delete[] m_nodesPtr;
-            m_nodesPtr = nullptr;
+            return;
         }
-        size_t nNodes = m_nodes.size();
-        if (nNodes > 0)
+
+        // leaves of the previous tree which changed since the last finalize
+        std::vector<uint32_t> changedLeafs;
+        bool incremental = m_nodesPtr && m_numNodesPtr > 0 && nNodes >= m_numNodesPtr;
+#ifdef USE_TREELETS
+        incremental = incremental && m_treeLetSlots.size() == m_numNodesPtr;
+#endif
+        if (incremental)
         {
-            m_nodesPtr = new KDNode[nNodes];
-            for (int n = 0; n < nNodes; n++)
+            tbb::concurrent_vector<uint32_t> changedNodes;
+            std::atomic<bool> restructured{false};
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, m_numNodesPtr, 4096), [&](tbb::blocked_range<size_t> r) {
+                for (size_t n = r.begin(); n < r.end(); n++)
+                {
+                    const KDNode &prevNode = m_nodesPtr[n];
+                    const KDNode &node = m_nodes[n];
+                    if (prevNode.splitPosition != node.splitPosition || prevNode.splitDimAndNodeIdx != node.splitDimAndNodeIdx)
+                    {
+                        if (prevNode.isLeaf())
+                        {
+                            changedNodes.push_back(n);
+                        }
+                        else
+                        {
+                            restructured = true;
+                        }
+                    }
+                }
+            });
+            incremental = !restructured;
+            changedLeafs.assign(changedNodes.begin(), changedNodes.end());
+            std::sort(changedLeafs.begin(), changedLeafs.end());
+        }
+
+        if (nNodes > m_nodesPtrCapacity)
+        {
+            // grows geometrically since updates usually only add a few nodes
+            const size_t capacity = std::max(nNodes, m_numNodesPtr + m_numNodesPtr / 2);
+            KDNode *nodesPtr = new KDNode[capacity];
+            if (incremental)
+            {
+                std::copy(m_nodesPtr, m_nodesPtr + m_numNodesPtr, nodesPtr);
+            }
+            delete[] m_nodesPtr;
+            m_nodesPtr = nodesPtr;
+            m_nodesPtrCapacity = capacity;
+        }
+
+        const size_t firstNewNode = incremental ? m_numNodesPtr : 0;
+        tbb::parallel_for(tbb::blocked_range<size_t>(firstNewNode, nNodes, 4096), [&](tbb::blocked_range<size_t> r) {
+            for (size_t n = r.begin(); n < r.end(); n++)
             {
                 m_nodesPtr[n] = m_nodes[n];
             }
+        });
+        for (const uint32_t n : changedLeafs)
+        {
+            m_nodesPtr[n] = m_nodes[n];
+        }
+        m_numNodesPtr = nNodes;
+
 #ifdef USE_TREELETS
+        if (incremental)
+        {
+            updateTreeLets(changedLeafs);
+        }
+        else
+        {
             buildTreeLets();
-#endif
         }
+#endif
     }
 
     void buildTreeLets()
     {
-        if (m_treeLets)
-        {
-            delete[] m_treeLets;
-            m_treeLets = nullptr;
-            m_numTreeLets = 0;
-        }
-
-        std::vector<KDTreeLet> treeLets;
-        treeLets.push_back(KDTreeLet());
-        insertNode(m_nodesPtr[0], 0, 0, 0, treeLets);
+        m_treeLets.clear();
+        m_treeLetSlots.clear();
+        m_treeLetSlots.resize(m_numNodesPtr);
+        m_treeLets.push_back(KDTreeLet());
+        insertNode(0, 0, 0, 0);
+    }
 
-        m_numTreeLets = treeLets.size();
-        m_treeLets = new KDTreeLet[m_numTreeLets];
-        for (int i = 0; i < m_numTreeLets; i++)
+    // re-inserts the (split) leaves into the slots they occupy in the treelets,
+    // the new child nodes are placed into free slots of the same treelet or into new treelets
+    void updateTreeLets(const std::vector<uint32_t> &changedLeafs)
+    {
+        m_treeLetSlots.resize(m_numNodesPtr);
+        for (const uint32_t n : changedLeafs)
         {
-            m_treeLets[i] = treeLets[i];
+            const uint32_t globalNodeId = m_treeLetSlots[n];
+            const uint32_t nodeIdx = globalNodeId % 8;
+            const uint32_t treeLetLevel = nodeIdx == 0 ? 0 : (nodeIdx < 3 ? 1 : 2);
+            insertNode(n, nodeIdx, globalNodeId / 8, treeLetLevel);
         }
     }
 
-    uint32_t insertNode(const KDNode &node, uint32_t nodeIdx, uint32_t treeLetIdx, uint32_t treeDepth, std::vector<KDTreeLet> &treeLets)
+    uint32_t insertNode(const uint32_t binaryNodeIdx, uint32_t nodeIdx, uint32_t treeLetIdx, uint32_t treeDepth)
     {
+        const KDNode &node = m_nodesPtr[binaryNodeIdx];
+        std::vector<KDTreeLet> &treeLets = m_treeLets;
         uint32_t treeLetLevel = treeDepth % 3;
         uint32_t globalNodeId = (treeLetIdx * 8) + nodeIdx;
+        m_treeLetSlots[binaryNodeIdx] = globalNodeId;
         treeLets[treeLetIdx].nodes[nodeIdx] = node;
         if (!node.isLeaf())
         {
             if (treeLetLevel == 0)
             {
                 uint32_t childIdx = node.getLeftChildIdx();
-                uint32_t newChildIdx = insertNode(m_nodesPtr[childIdx], 1, treeLetIdx, treeDepth + 1, treeLets);
-                insertNode(m_nodesPtr[childIdx + 1], 2, treeLetIdx, treeDepth + 1, treeLets);
+                uint32_t newChildIdx = insertNode(childIdx, 1, treeLetIdx, treeDepth + 1);
+                insertNode(childIdx + 1, 2, treeLetIdx, treeDepth + 1);
                 treeLets[treeLetIdx].nodes[nodeIdx].setLeftChildIdx(newChildIdx);
                 OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
                 OPENPGL_ASSERT(node.getSplitPivot() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitPivot());
@@ -356,8 +500,8 @@ struct KDTree
                 if (nodeIdx == 1)
                 {
                     uint32_t childIdx = node.getLeftChildIdx();
-                    uint32_t newChildIdx = insertNode(m_nodesPtr[childIdx], 3, treeLetIdx, treeDepth + 1, treeLets);
-                    insertNode(m_nodesPtr[childIdx + 1], 4, treeLetIdx, treeDepth + 1, treeLets);
+                    uint32_t newChildIdx = insertNode(childIdx, 3, treeLetIdx, treeDepth + 1);
+                    insertNode(childIdx + 1, 4, treeLetIdx, treeDepth + 1);
                     treeLets[treeLetIdx].nodes[nodeIdx].setLeftChildIdx(newChildIdx);
                     OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
                     OPENPGL_ASSERT(node.getSplitPivot() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitPivot());
@@ -366,8 +510,8 @@ struct KDTree
                 else if (nodeIdx == 2)
                 {
                     uint32_t childIdx = node.getLeftChildIdx();
-                    uint32_t newChildIdx = insertNode(m_nodesPtr[childIdx], 5, treeLetIdx, treeDepth + 1, treeLets);
-                    insertNode(m_nodesPtr[childIdx + 1], 6, treeLetIdx, treeDepth + 1, treeLets);
+                    uint32_t newChildIdx = insertNode(childIdx, 5, treeLetIdx, treeDepth + 1);
+                    insertNode(childIdx + 1, 6, treeLetIdx, treeDepth + 1);
                     treeLets[treeLetIdx].nodes[nodeIdx].setLeftChildIdx(newChildIdx);
                     OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
                     OPENPGL_ASSERT(node.getSplitPivot() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitPivot());
@@ -386,9 +530,9 @@ struct KDTree
                 treeLets.push_back(KDTreeLet());
                 OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
                 uint32_t leftTreeLetIdx = treeLets.size() - 2;
-                insertNode(m_nodesPtr[childIdx], 0, leftTreeLetIdx, treeDepth + 1, treeLets);
+                insertNode(childIdx, 0, leftTreeLetIdx, treeDepth + 1);
                 OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
-                insertNode(m_nodesPtr[childIdx + 1], 0, leftTreeLetIdx + 1, treeDepth + 1, treeLets);
+                insertNode(childIdx + 1, 0, leftTreeLetIdx + 1, treeDepth + 1);
                 OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
                 treeLets[treeLetIdx].nodes[nodeIdx].setLeftChildIdx(leftTreeLetIdx);
                 OPENPGL_ASSERT(node.getSplitDim() == treeLets[treeLetIdx].nodes[nodeIdx].getSplitDim());
@@ -452,6 +596,383 @@ struct KDTree
         return treeLet.nodes[nodeIdx].getDataIdx();
     }
 #endif
+
+    // look-up which uses (and updates) the path of the previous look-up stored in cache:
+    // if pos lies in the same leaf no traversal is needed, otherwise the traversal starts
+    // from the deepest node of the cached path which contains pos (the root always does)
+    // note: the cache has to be reset each time the tree changes
+    uint32_t getDataIdxAtPos(const Vector3 &pos, KDTreeLookUpCache &cache) const
+    {
+        OPENPGL_ASSERT(m_isInit);
+        OPENPGL_ASSERT(embree::inside(m_bounds, pos));
+
+        cache.numLookUps.store(cache.numLookUps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        uint32_t pathIdx = 0;
+        if (cache.pathLength > 0)
+        {
+            pathIdx = cache.pathLength - 1;
+            if (cache.contains(pathIdx, pos))
+            {
+                cache.numHits.store(cache.numHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return cache.dataIdx;
+            }
+            // the bounds along the path are nested: binary search for the deepest node containing pos
+            uint32_t lower = 0;
+            while (pathIdx - lower > 1)
+            {
+                const uint32_t mid = (lower + pathIdx) / 2;
+                if (cache.contains(mid, pos))
+                {
+                    lower = mid;
+                }
+                else
+                {
+                    pathIdx = mid;
+                }
+            }
+            pathIdx = lower;
+        }
+        else
+        {
+            cache.path[0] = 0;
+            cache.pathBounds[0] = m_bounds;
+        }
+
+        uint32_t nodeIdx = cache.path[pathIdx];
+        BBox bounds = cache.pathBounds[pathIdx];
+        while (!m_nodesPtr[nodeIdx].isLeaf())
+        {
+            uint8_t splitDim = m_nodesPtr[nodeIdx].getSplitDim();
+            float pivot = m_nodesPtr[nodeIdx].getSplitPivot();
+
+            nodeIdx = m_nodesPtr[nodeIdx].getLeftChildIdx();
+            if (pos[splitDim] >= pivot)
+            {
+                nodeIdx++;
+                bounds.lower[splitDim] = pivot;
+            }
+            else
+            {
+                bounds.upper[splitDim] = pivot;
+            }
+            // for paths exceeding the cache the last entry is overwritten until the leaf is reached
+            pathIdx = std::min(pathIdx + 1, KDTreeLookUpCache::MAX_PATH_LENGTH - 1);
+            cache.path[pathIdx] = nodeIdx;
+            cache.pathBounds[pathIdx] = bounds;
+        }
+        cache.pathLength = pathIdx + 1;
+        cache.dataIdx = m_nodesPtr[nodeIdx].getDataIdx();
+        return cache.dataIdx;
+    }
+
+    // builds the wide representation of the (finalized) tree used by getDataIdxAtPosWide
+    template <int Width>
+    void buildWideNodes()
+    {
+        m_wideNodes.clear();
+        if (m_nodesPtr && m_nodes.size() > 0)
+        {
+            m_wideNodes.emplace_back();
+            insertWideNode<Width>(0, 0);
+        }
+    }
+
+    template <int Width>
+    void insertWideNode(const uint32_t nodeIdx, const uint32_t wideNodeIdx)
+    {
+        static_assert(Width == 4 || Width == 8, "the wide KD-tree supports 4 and 8 children per node");
+        // binary nodes covered by the wide node in heap order, the last Width entries are the children
+        uint32_t slots[2 * Width - 1];
+        slots[0] = nodeIdx;
+        for (int s = 0; s < Width - 1; s++)
+        {
+            const KDNode &node = m_nodesPtr[slots[s]];
+            KDWideNode &wideNode = m_wideNodes[wideNodeIdx];
+            if (node.isLeaf())
+            {
+                // a leaf above the last level: the plane is never passed, all children below point to the leaf
+                wideNode.splitPivots[s] = std::numeric_limits<float>::infinity();
+                wideNode.splitDims[s] = 0;
+                slots[2 * s + 1] = slots[s];
+                slots[2 * s + 2] = slots[s];
+            }
+            else
+            {
+                wideNode.splitPivots[s] = node.getSplitPivot();
+                wideNode.splitDims[s] = node.getSplitDim();
+                slots[2 * s + 1] = node.getLeftChildIdx();
+                slots[2 * s + 2] = node.getLeftChildIdx() + 1;
+            }
+        }
+        for (int c = 0; c < Width; c++)
+        {
+            const KDNode &child = m_nodesPtr[slots[Width - 1 + c]];
+            if (child.isLeaf())
+            {
+                m_wideNodes[wideNodeIdx].children[c] = KDWideNode::ELeafFlag | child.getDataIdx();
+            }
+            else
+            {
+                const uint32_t childIdx = m_wideNodes.size();
+                m_wideNodes.emplace_back();
+                m_wideNodes[wideNodeIdx].children[c] = childIdx;
+                insertWideNode<Width>(slots[Width - 1 + c], childIdx);
+            }
+        }
+    }
+
+    // look-up using the wide representation of the tree: all split planes of a node
+    // are compared at once and the resulting bit mask selects the child
+    template <int Width>
+    uint32_t getDataIdxAtPosWide(const Vector3 &pos) const
+    {
+        using vint = embree::vint<Width>;
+        using vfloat = embree::vfloat<Width>;
+        OPENPGL_ASSERT(m_isInit);
+        OPENPGL_ASSERT(m_wideNodes.size() > 0);
+        OPENPGL_ASSERT(embree::inside(m_bounds, pos));
+
+        const vfloat posX(pos.x);
+        const vfloat posY(pos.y);
+        const vfloat posZ(pos.z);
+        const int numLevels = Width == 8 ? 3 : 2;
+        uint32_t nodeIdx = 0;
+        while (true)
+        {
+            const KDWideNode &node = m_wideNodes[nodeIdx];
+            const vint splitDims = vint::loadu(node.splitDims);
+            const vfloat p = select(splitDims == vint(0), posX, select(splitDims == vint(1), posY, posZ));
+            const size_t mask = embree::movemask(p >= vfloat::loadu(node.splitPivots));
+            size_t slot = 0;
+            for (int l = 0; l < numLevels; l++)
+            {
+                slot = 2 * slot + 1 + ((mask >> slot) & 1);
+            }
+            const uint32_t child = node.children[slot - (Width - 1)];
+            if (child & KDWideNode::ELeafFlag)
+            {
+                return child & ~uint32_t(KDWideNode::ELeafFlag);
+            }
+            nodeIdx = child;
+        }
+    }
+
+    // packet version of getDataIdxAtPos which traverses the tree for VecSize positions at once,
+    // the data indices of the inactive lanes (valid == false) are undefined
+    template <int VecSize>
+    embree::vint<VecSize> getDataIdxAtPos(const embree::Vec3<embree::vfloat<VecSize>> &pos, const embree::vbool<VecSize> &valid) const
+    {
+        using vint = embree::vint<VecSize>;
+        using vfloat = embree::vfloat<VecSize>;
+        using vbool = embree::vbool<VecSize>;
+        OPENPGL_ASSERT(m_isInit);
+
+        // the nodes are addressed as an array of (splitPosition, splitDimAndNodeIdx) pairs,
+        // gathering with a scale of sizeof(KDNode) loads the member of the node at each index
+#ifdef USE_TREELETS
+        const int *nodes = reinterpret_cast<const int *>(m_treeLets.data());
+#else
+        const int *nodes = reinterpret_cast<const int *>(m_nodesPtr);
+#endif
+        const vint leafNode(KDNode::ELeafNode);
+        const vint idxMask(int((1U << 30) - 1));
+        vint nodeIdx(0);
+        vint nodeData = vint::template gather<sizeof(KDNode)>(valid, nodes + 1, nodeIdx);
+        vbool active = valid & (embree::srl(nodeData, 30) != leafNode);
+#ifdef USE_TREELETS
+        uint32_t depth = 0;
+#endif
+        while (embree::any(active))
+        {
+            const vfloat pivot = embree::asFloat(vint::template gather<sizeof(KDNode)>(active, nodes, nodeIdx));
+            const vint splitDim = embree::srl(nodeData, 30);
+            const vfloat p = select(splitDim == vint(0), pos.x, select(splitDim == vint(1), pos.y, pos.z));
+            vint childIdx = (nodeData & idxMask) + select(p >= pivot, vint(1), vint(0));
+#ifdef USE_TREELETS
+            // every third level the traversal continues at the root of a child treelet
+            if (depth % 3 == 2)
+            {
+                childIdx = childIdx * vint(8);
+            }
+            depth++;
+#endif
+            nodeIdx = select(active, childIdx, nodeIdx);
+            nodeData = select(active, vint::template gather<sizeof(KDNode)>(active, nodes + 1, nodeIdx), nodeData);
+            active = active & (embree::srl(nodeData, 30) != leafNode);
+        }
+        return nodeData & idxMask;
+    }
+
+    // builds the look-up grid of the (finalized) tree used by getDataIdxAtPosGrid: a uniform grid
+    // with about cellsPerLeaf cells per leaf over the bounds of the tree, each cell stores the leaf
+    // covering the whole cell or, if the cell is cut by a split plane, the deepest node containing it
+    void buildLookUpGrid(const float cellsPerLeaf = 4.f)
+    {
+        m_gridCells.clear();
+        if (!m_nodesPtr || m_numNodesPtr == 0)
+        {
+            return;
+        }
+
+        const size_t maxNumCells = size_t(1) << 22;
+        const size_t numLeaves = (m_numNodesPtr + 1) / 2;
+        const size_t numCells = std::min(maxNumCells, std::max(size_t(1), size_t(float(numLeaves) * cellsPerLeaf)));
+        const Vector3 extent = m_bounds.size();
+        const float volume = extent.x * extent.y * extent.z;
+        const float cellSize = volume > 0.f ? std::cbrt(volume / float(numCells)) : 0.f;
+        for (int d = 0; d < 3; d++)
+        {
+            m_gridRes[d] = cellSize > 0.f ? std::min(1024, std::max(1, int(std::ceil(extent[d] / cellSize)))) : 1;
+        }
+        // the rounding up of the resolutions can exceed the cell budget for very flat bounds
+        while (size_t(m_gridRes[0]) * size_t(m_gridRes[1]) * size_t(m_gridRes[2]) > maxNumCells)
+        {
+            int &res = m_gridRes[0] >= m_gridRes[1] && m_gridRes[0] >= m_gridRes[2] ? m_gridRes[0] : (m_gridRes[1] >= m_gridRes[2] ? m_gridRes[1] : m_gridRes[2]);
+            res = (res + 1) / 2;
+        }
+        for (int d = 0; d < 3; d++)
+        {
+            m_gridScale[d] = extent[d] > 0.f ? float(m_gridRes[d]) / extent[d] : 0.f;
+        }
+
+        m_gridCells.resize(size_t(m_gridRes[0]) * size_t(m_gridRes[1]) * size_t(m_gridRes[2]));
+        const int lower[3] = {0, 0, 0};
+        const int upper[3] = {m_gridRes[0] - 1, m_gridRes[1] - 1, m_gridRes[2] - 1};
+        insertGridNode(0, lower, upper);
+    }
+
+    // assigns the cells in [lower, upper] (inclusive) to the node or its descendants, a cell is passed to
+    // a child if all positions mapping to the cell lie on the child's side of the split plane; since the
+    // mapping from positions to cells is monotonic this is the case for all cells except the one of the plane
+    void insertGridNode(const uint32_t nodeIdx, const int lower[3], const int upper[3])
+    {
+        const KDNode &node = m_nodesPtr[nodeIdx];
+        if (node.isLeaf())
+        {
+            fillGridCells(lower, upper, uint32_t(EGridLeafFlag) | node.getDataIdx());
+            return;
+        }
+
+        const uint8_t splitDim = node.getSplitDim();
+        const int splitCell = getGridCellCoord(node.getSplitPivot(), splitDim);
+        if (splitCell >= lower[splitDim] && splitCell <= upper[splitDim])
+        {
+            int planeLower[3] = {lower[0], lower[1], lower[2]};
+            int planeUpper[3] = {upper[0], upper[1], upper[2]};
+            planeLower[splitDim] = planeUpper[splitDim] = splitCell;
+            fillGridCells(planeLower, planeUpper, nodeIdx);
+        }
+
+        int leftUpper[3] = {upper[0], upper[1], upper[2]};
+        leftUpper[splitDim] = std::min(upper[splitDim], splitCell - 1);
+        int rightLower[3] = {lower[0], lower[1], lower[2]};
+        rightLower[splitDim] = std::max(lower[splitDim], splitCell + 1);
+        const bool insertLeft = leftUpper[splitDim] >= lower[splitDim];
+        const bool insertRight = rightLower[splitDim] <= upper[splitDim];
+        const uint32_t leftChildIdx = node.getLeftChildIdx();
+
+        // the subtrees fill disjoint cells and are processed in parallel as long as they are large enough
+        const size_t numCells = size_t(upper[0] - lower[0] + 1) * size_t(upper[1] - lower[1] + 1) * size_t(upper[2] - lower[2] + 1);
+        if (insertLeft && insertRight && numCells > 4096)
+        {
+            tbb::parallel_invoke([&]() { insertGridNode(leftChildIdx, lower, leftUpper); }, [&]() { insertGridNode(leftChildIdx + 1, rightLower, upper); });
+        }
+        else
+        {
+            if (insertLeft)
+                insertGridNode(leftChildIdx, lower, leftUpper);
+            if (insertRight)
+                insertGridNode(leftChildIdx + 1, rightLower, upper);
+        }
+    }
+
+    void fillGridCells(const int lower[3], const int upper[3], const uint32_t value)
+    {
+        for (int z = lower[2]; z <= upper[2]; z++)
+        {
+            for (int y = lower[1]; y <= upper[1]; y++)
+            {
+                uint32_t *row = &m_gridCells[(size_t(z) * m_gridRes[1] + y) * m_gridRes[0]];
+                std::fill(row + lower[0], row + upper[0] + 1, value);
+            }
+        }
+    }
+
+    inline int getGridCellCoord(const float pos, const int dim) const
+    {
+        const float cell = (pos - m_bounds.lower[dim]) * m_gridScale[dim];
+        return int(std::min(std::max(cell, 0.f), float(m_gridRes[dim] - 1)));
+    }
+
+    // look-up using the grid: constant time if the cell lies inside a single leaf,
+    // otherwise the traversal continues at the node stored in the cell
+    uint32_t getDataIdxAtPosGrid(const Vector3 &pos) const
+    {
+        OPENPGL_ASSERT(m_isInit);
+        OPENPGL_ASSERT(m_gridCells.size() > 0);
+        OPENPGL_ASSERT(embree::inside(m_bounds, pos));
+
+        const size_t cellIdx = (size_t(getGridCellCoord(pos.z, 2)) * m_gridRes[1] + getGridCellCoord(pos.y, 1)) * m_gridRes[0] + getGridCellCoord(pos.x, 0);
+        const uint32_t cell = m_gridCells[cellIdx];
+        if (cell & EGridLeafFlag)
+        {
+            return cell & ~uint32_t(EGridLeafFlag);
+        }
+
+        uint32_t nodeIdx = cell;
+        while (!m_nodesPtr[nodeIdx].isLeaf())
+        {
+            uint8_t splitDim = m_nodesPtr[nodeIdx].getSplitDim();
+            float pivot = m_nodesPtr[nodeIdx].getSplitPivot();
+
+            nodeIdx = m_nodesPtr[nodeIdx].getLeftChildIdx();
+            nodeIdx += pos[splitDim] >= pivot ? 1 : 0;
+        }
+        return m_nodesPtr[nodeIdx].getDataIdx();
+    }
+
+    // packet version of getDataIdxAtPosGrid, the data indices of the inactive lanes (valid == false) are undefined
+    template <int VecSize>
+    embree::vint<VecSize> getDataIdxAtPosGrid(const embree::Vec3<embree::vfloat<VecSize>> &pos, const embree::vbool<VecSize> &valid) const
+    {
+        using vint = embree::vint<VecSize>;
+        using vfloat = embree::vfloat<VecSize>;
+        using vbool = embree::vbool<VecSize>;
+        OPENPGL_ASSERT(m_isInit);
+        OPENPGL_ASSERT(m_gridCells.size() > 0);
+
+        // same (monotonic) mapping as getGridCellCoord, the clamped values are exact integers
+        vint cellCoords[3];
+        for (int d = 0; d < 3; d++)
+        {
+            const vfloat cell = (pos[d] - vfloat(m_bounds.lower[d])) * vfloat(m_gridScale[d]);
+            cellCoords[d] = embree::floori(embree::min(embree::max(cell, vfloat(0.f)), vfloat(float(m_gridRes[d] - 1))));
+        }
+        const vint cellIdx = (cellCoords[2] * vint(m_gridRes[1]) + cellCoords[1]) * vint(m_gridRes[0]) + cellCoords[0];
+        const vint cells = vint::template gather<4>(valid, reinterpret_cast<const int *>(m_gridCells.data()), cellIdx);
+        const vbool isGridLeaf = (cells & vint(int(EGridLeafFlag))) != vint(0);
+
+        // the remaining lanes traverse the binary tree starting at the node stored in their cell
+        const int *nodes = reinterpret_cast<const int *>(m_nodesPtr);
+        const vint leafNode(KDNode::ELeafNode);
+        const vint idxMask(int((1U << 30) - 1));
+        vbool active = valid & !isGridLeaf;
+        vint nodeIdx = select(active, cells, vint(0));
+        vint nodeData = vint::template gather<sizeof(KDNode)>(active, nodes + 1, nodeIdx);
+        active = active & (embree::srl(nodeData, 30) != leafNode);
+        while (embree::any(active))
+        {
+            const vfloat pivot = embree::asFloat(vint::template gather<sizeof(KDNode)>(active, nodes, nodeIdx));
+            const vint splitDim = embree::srl(nodeData, 30);
+            const vfloat p = select(splitDim == vint(0), pos.x, select(splitDim == vint(1), pos.y, pos.z));
+            const vint childIdx = (nodeData & idxMask) + select(p >= pivot, vint(1), vint(0));
+            nodeIdx = select(active, childIdx, nodeIdx);
+            nodeData = select(active, vint::template gather<sizeof(KDNode)>(active, nodes + 1, nodeIdx), nodeData);
+            active = active & (embree::srl(nodeData, 30) != leafNode);
+        }
+        return select(isGridLeaf, cells & vint(int(~uint32_t(EGridLeafFlag))), nodeData & idxMask);
+    }
+
     uint32_t getMaxNodeDepth(const KDNode &node) const
     {
         if (node.isLeaf())
@@ -632,7 +1153,13 @@ struct KDTree
         size_t num_nodes = 0;
         stream.read(reinterpret_cast<char *>(&num_nodes), sizeof(size_t));
         m_nodes.reserve(num_nodes);
+        if (m_nodesPtr)
+        {
+            delete[] m_nodesPtr;
+        }
         m_nodesPtr = new KDNode[num_nodes];
+        m_nodesPtrCapacity = num_nodes;
+        m_numNodesPtr = num_nodes;
         for (size_t n = 0; n < num_nodes; n++)
         {
             KDNode node;
@@ -646,11 +1173,44 @@ struct KDTree
 #endif
     }
 
+    // deep copies the tree (build nodes, query nodes and treelets) from another KDTree
+    void copyFrom(const KDTree &b)
+    {
+        m_isInit = b.m_isInit;
+        m_bounds = b.m_bounds;
+        m_nodes = b.m_nodes;
+
+        if (m_nodesPtr)
+        {
+            delete[] m_nodesPtr;
+            m_nodesPtr = nullptr;
+        }
+        m_nodesPtrCapacity = 0;
+        m_numNodesPtr = 0;
+        if (b.m_nodesPtr)
+        {
+            m_numNodesPtr = b.m_numNodesPtr;
+            m_nodesPtrCapacity = m_numNodesPtr;
+            m_nodesPtr = new KDNode[m_numNodesPtr];
+            std::copy(b.m_nodesPtr, b.m_nodesPtr + m_numNodesPtr, m_nodesPtr);
+        }
+
+        m_treeLets = b.m_treeLets;
+        m_treeLetSlots = b.m_treeLetSlots;
+        m_wideNodes = b.m_wideNodes;
+
+        m_gridCells = b.m_gridCells;
+        m_gridRes[0] = b.m_gridRes[0];
+        m_gridRes[1] = b.m_gridRes[1];
+        m_gridRes[2] = b.m_gridRes[2];
+        m_gridScale = b.m_gridScale;
+    }
+
     bool operator==(const KDTree &b) const
     {
         bool equal = true;
         if (m_isInit != b.m_isInit || m_bounds.lower.x != b.m_bounds.lower.x || m_bounds.lower.y != b.m_bounds.lower.y || m_bounds.lower.z != b.m_bounds.lower.z ||
-            m_bounds.upper.x != b.m_bounds.upper.x || m_bounds.upper.y != b.m_bounds.upper.y || m_bounds.upper.z != b.m_bounds.upper.z || m_numTreeLets != b.m_numTreeLets)
+            m_bounds.upper.x != b.m_bounds.upper.x || m_bounds.upper.y != b.m_bounds.upper.y || m_bounds.upper.z != b.m_bounds.upper.z || m_treeLets.size() != b.m_treeLets.size())
         {
             equal = false;
         }
@@ -691,7 +1251,7 @@ struct KDTree
     KDTreeStatistics getStatistics() const
     {
         KDTreeStatistics treeStats;
-        treeStats.maxDepth = calculateMaxDepth(m_nodes[0]);
+        treeStats.maxDepth = m_nodes.size() > 0 ? calculateMaxDepth(m_nodes[0]) : 0;
         treeStats.numberOfNodes = m_nodes.size();
         treeStats.sizePerNode = sizeof(KDNode);
         treeStats.numberOfReservedNodes = m_nodes.capacity();
@@ -711,9 +1271,22 @@ struct KDTree
 
     // node storage used during querying
     KDNode *m_nodesPtr{nullptr};
-
-    KDTreeLet *m_treeLets{nullptr};
-    int m_numTreeLets{0};
+    // number of nodes in m_nodesPtr (the nodes of the tree at the last finalize) and its capacity
+    size_t m_numNodesPtr{0};
+    size_t m_nodesPtrCapacity{0};
+
+    std::vector<KDTreeLet> m_treeLets;
+    // global treelet node id (treeLetIdx * 8 + nodeIdx) of each node of m_nodesPtr
+    std::vector<uint32_t> m_treeLetSlots;
+
+    // optional wide representation of the tree used for querying (see buildWideNodes)
+    std::vector<KDWideNode> m_wideNodes;
+
+    // optional look-up grid over the bounds of the tree (see buildLookUpGrid), each cell stores
+    // the data index of a leaf (EGridLeafFlag set) or the index of the node to continue the traversal from
+    std::vector<uint32_t> m_gridCells;
+    int m_gridRes[3]{0, 0, 0};
+    Vector3 m_gridScale{0.f, 0.f, 0.f};
 };
 
 }  // namespace openpgl
\ No newline at end of file
@@ -13,6 +13,11 @@
 #define TASKING_TBB
 #include <embreeSrc/common/algorithms/parallel_partition.h>
 #include <embreeSrc/common/algorithms/parallel_reduce.h>
+#include <embreeSrc/common/algorithms/parallel_sort.h>
+#else
+#include <tbb/parallel_sort.h>
+
+#include "ParallelPartition.h"
 #endif
 /*
 #if !defined(__WIN32__) and !defined(__MACOSX__)
@@ -37,16 +42,22 @@ struct KDTreePartitionBuilder
 
     typedef KDTree SpatialStructure;
 
-#ifdef USE_EMBREE_PARALLEL
     static const size_t PARALLEL_THRESHOLD = 4 * 1024;
     static const size_t PARALLEL_PARTITION_BLOCK_SIZE = 4 * 1024;
-#endif
 
     struct Settings
     {
         size_t minSamples{100};
         size_t maxSamples{PGL_TREE_MAX_SAMPLE_PER_LEAF};
         size_t maxDepth{32};
+        // number of bins per axis of the binned split heuristic (see getBinnedSplitDimensionAndPosition),
+        // 0 splits at the sample mean along the axis of the largest variance
+        // note: only affects the build and is therefore not stored with the field
+        size_t numSplitBins{0};
+        // builds the initial tree top-down from the Morton codes of the samples (see buildMorton)
+        // instead of successively partitioning all samples from the root
+        // note: only affects the build and is therefore not stored with the field
+        bool mortonBuild{false};
 
         void serialize(std::ostream &stream) const;
         void deserialize(std::istream &stream);
@@ -69,10 +80,21 @@ struct KDTreePartitionBuilder
         dataStorage.resize(1);
         dataStorage[0].first.regionBounds = bounds;
 
-        updateTree(kdTree, samples, dataStorage, buildSettings);
+        if (buildSettings.mortonBuild)
+        {
+            buildMorton(kdTree, samples, dataStorage, buildSettings);
+        }
+        else
+        {
+            updateTree(kdTree, samples, dataStorage, buildSettings);
+        }
     }
 
-    void updateTree(KDTree &kdTree, TSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage, const Settings &buildSettings) const
+    // if touchedDataIdxs is given the indices of all regions which received samples
+    // or were created/modified by a split during the update are appended to it
+    // note: the lookup structures of the tree are not updated, kdTree.finalize() has to be called afterwards
+    void updateTree(KDTree &kdTree, TSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage, const Settings &buildSettings,
+                    tbb::concurrent_vector<uint32_t> *touchedDataIdxs = nullptr) const
     {
         int numEstLeafs = dataStorage.size() + (samples.size() * 2) / buildSettings.maxSamples + 32;
         kdTree.m_nodes.reserve(4 * numEstLeafs);
@@ -109,20 +131,29 @@ struct KDTreePartitionBuilder
                     return IntegerSampleStatistics::merge(a, b);
                 });
 #else
-            IntegerSampleStatistics iSampleStats(bounds);
-            for (const auto &sample : samples)
-            {
-                const Point3 samplePosition(sample.position.x, sample.position.y, sample.position.z);
-                iSampleStats.addSample(samplePosition);
-            }
+            IntegerSampleStatistics iSampleStats = tbb::parallel_reduce(
+                tbb::blocked_range<size_t>(0, samples.size(), PARALLEL_PARTITION_BLOCK_SIZE), IntegerSampleStatistics(bounds),
+                [&](const tbb::blocked_range<size_t> &r, IntegerSampleStatistics stats) -> IntegerSampleStatistics {
+                    for (size_t i = r.begin(); i < r.end(); i++)
+                    {
+                        const PGLSampleData sample = samples[i];
+                        const Point3 samplePosition(sample.position.x, sample.position.y, sample.position.z);
+                        stats.addSample(samplePosition);
+                    }
+                    return stats;
+                },
+                [](const IntegerSampleStatistics &a, const IntegerSampleStatistics &b) {
+                    return IntegerSampleStatistics::merge(a, b);
+                });
 #endif
             sampleStats = iSampleStats.getSampleStatistics();
         }
-        updateTreeNode(&kdTree, root, depth, bounds, samples, sampleRange, sampleStats, &dataStorage, buildSettings);
-        kdTree.finalize();
+        updateTreeNode(&kdTree, root, depth, bounds, samples, sampleRange, sampleStats, &dataStorage, touchedDataIdxs, buildSettings);
     }
 
-    void insertTree(KDTree &kdTree, TZeroValueSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage) const
+    // if touchedDataIdxs is given the indices of all regions which received zero-value samples are appended to it
+    void insertTree(KDTree &kdTree, TZeroValueSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage,
+                    tbb::concurrent_vector<uint32_t> *touchedDataIdxs = nullptr) const
     {
         KDNode &root = kdTree.getRoot();
 
@@ -132,43 +163,339 @@ struct KDTreePartitionBuilder
 
         size_t depth = 1;
 
-        insertTreeNode(&kdTree, root, depth, samples, sampleRange, &dataStorage);
+        insertTreeNode(&kdTree, root, depth, samples, sampleRange, &dataStorage, touchedDataIdxs);
+    }
+
+    // assigns the samples to the leaves/regions they fall into (i.e., sets the sample ranges of the regions)
+    // without splitting the leaves or updating the sample statistics of the regions, e.g., for samples which
+    // were already added to the tree in chunks using updateTree
+    // if touchedDataIdxs is given the indices of all regions which received samples are appended to it
+    void partitionTree(KDTree &kdTree, TSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage,
+                       tbb::concurrent_vector<uint32_t> *touchedDataIdxs = nullptr) const
+    {
+        KDNode &root = kdTree.getRoot();
+
+        Range sampleRange;
+        sampleRange.m_begin = 0;
+        sampleRange.m_end = samples.size();
+
+        partitionTreeNode(&kdTree, root, samples, sampleRange, &dataStorage, touchedDataIdxs);
+    }
+
+    // reduces the number of leaves/regions to maxNumLeaves by collapsing the inner nodes with two
+    // leaf children, which received the lowest number of samples, back into leaves, afterwards the
+    // tree and the data storage are compacted
+    // mergeRegions(region, otherRegion) merges the distribution of otherRegion into region
+    // returns if the tree was modified (i.e., kdTree.finalize() has to be called afterwards)
+    template <typename TMergeRegions>
+    bool coarsenTree(KDTree &kdTree, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage, const size_t maxNumLeaves, TMergeRegions mergeRegions) const
+    {
+        size_t numLeaves = dataStorage.size();
+        if (numLeaves <= maxNumLeaves)
+        {
+            return false;
+        }
+
+        struct CoarsenCandidate
+        {
+            float numSamples;
+            Vector3 lower;
+            uint32_t nodeIdx;
+        };
+        // the node indices depend on the order of the parallel build, therefore the lower corner
+        // of the (disjoint) candidate regions is used to break ties to keep the coarsening deterministic
+        auto candidateLess = [](const CoarsenCandidate &a, const CoarsenCandidate &b) {
+            return a.numSamples < b.numSamples ||
+                   (a.numSamples == b.numSamples &&
+                    (a.lower.x < b.lower.x || (a.lower.x == b.lower.x && (a.lower.y < b.lower.y || (a.lower.y == b.lower.y && a.lower.z < b.lower.z)))));
+        };
+
+        std::vector<CoarsenCandidate> candidates;
+        std::vector<uint32_t> stack;
+        while (numLeaves > maxNumLeaves)
+        {
+            candidates.clear();
+            stack.push_back(0);
+            while (!stack.empty())
+            {
+                const uint32_t nodeIdx = stack.back();
+                stack.pop_back();
+                const KDNode &node = kdTree.getNode(nodeIdx);
+                if (node.isLeaf())
+                {
+                    continue;
+                }
+                const uint32_t leftIdx = node.getLeftChildIdx();
+                const KDNode &left = kdTree.getNode(leftIdx);
+                const KDNode &right = kdTree.getNode(leftIdx + 1);
+                if (left.isLeaf() && right.isLeaf())
+                {
+                    const TRegion &leftRegion = dataStorage[left.getDataIdx()].first;
+                    const TRegion &rightRegion = dataStorage[right.getDataIdx()].first;
+                    candidates.push_back({leftRegion.sampleStatistics.numSamples + rightRegion.sampleStatistics.numSamples, leftRegion.regionBounds.lower, nodeIdx});
+                }
+                else
+                {
+                    stack.push_back(leftIdx);
+                    stack.push_back(leftIdx + 1);
+                }
+            }
+            if (candidates.empty())
+            {
+                break;
+            }
+
+            const size_t numCollapse = std::min(candidates.size(), numLeaves - maxNumLeaves);
+            std::partial_sort(candidates.begin(), candidates.begin() + numCollapse, candidates.end(), candidateLess);
+            for (size_t i = 0; i < numCollapse; i++)
+            {
+                collapseTreeNode(kdTree, kdTree.getNode(candidates[i].nodeIdx), dataStorage, mergeRegions);
+            }
+            numLeaves -= numCollapse;
+        }
+
+        // remove the unused nodes and regions
+        std::vector<uint32_t> dataIdxs;
+        kdTree.compact(dataIdxs);
+        tbb::concurrent_vector<std::pair<TRegion, Range> > compactedDataStorage;
+        compactedDataStorage.grow_by(dataIdxs.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, dataIdxs.size()), [&](tbb::blocked_range<size_t> r) {
+            for (size_t i = r.begin(); i < r.end(); i++)
+            {
+                compactedDataStorage[i] = dataStorage[dataIdxs[i]];
+            }
+        });
+        dataStorage.swap(compactedDataStorage);
+        return true;
     }
 
     std::string toString() const;
 
    private:
-    template <class TContainer>
-    inline typename TContainer::iterator pivotSplitSamples(typename TContainer::iterator begin, typename TContainer::iterator end, uint8_t splitDimension, float pivot) const
+    static const int MORTON_BITS_PER_DIM = 10;
+
+    // the Morton code of a sample position and the index of the sample
+    struct MortonCode
     {
-        std::function<bool(typename TContainer::value_type)> pivotSplitPredicate = [splitDimension, pivot](typename TContainer::value_type sample) -> bool {
-            const Vector3 samplePosition(sample.position.x, sample.position.y, sample.position.z);
-            return samplePosition[splitDimension] < pivot;
-        };
-        return std::partition(begin, end, pivotSplitPredicate);
+        uint32_t code;
+        uint32_t idx;
+
+        // key used by the radix sort
+        operator uint32_t() const
+        {
+            return code;
+        }
+    };
+
+    // inserts two zero bits in front of each of the lower MORTON_BITS_PER_DIM bits of v
+    static inline uint32_t expandMortonBits(uint32_t v)
+    {
+        v &= 0x3ff;
+        v = (v | v << 16) & 0x30000ff;
+        v = (v | v << 8) & 0x300f00f;
+        v = (v | v << 4) & 0x30c30c3;
+        v = (v | v << 2) & 0x9249249;
+        return v;
     }
 
-    inline typename TSamplesContainer::iterator pivotSplitSamplesWithStats(typename TSamplesContainer::iterator begin, typename TSamplesContainer::iterator end,
-                                                                           uint8_t splitDimension, float pivot, SampleStatistics &statsLeft, SampleStatistics &statsRight) const
+    // bulk build of a tree which only consists of the root: the sample positions are quantized to a grid of
+    // 2^MORTON_BITS_PER_DIM cells per dimension inside the bounds of the tree and sorted by their Morton codes,
+    // the tree is then emitted top-down from the common code prefixes of the samples (see buildMortonTreeNode)
+    // which avoids partitioning the whole sample array at each level of the tree, leaves which still contain
+    // too many samples at the resolution of the grid are further split by updateTreeNode
+    void buildMorton(KDTree &kdTree, TSamplesContainer &samples, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage, const Settings &buildSettings) const
     {
-        std::function<bool(typename TSamplesContainer::value_type)> pivotSplitPredicate = [splitDimension, pivot, &statsLeft,
-                                                                                           &statsRight](typename TSamplesContainer::value_type sample) -> bool {
-            const Vector3 samplePosition(sample.position.x, sample.position.y, sample.position.z);
-            bool left = samplePosition[splitDimension] < pivot;
-            if (left)
+        OPENPGL_ASSERT(kdTree.getRoot().isLeaf());
+        const size_t numSamples = samples.size();
+        if (numSamples == 0)
+        {
+            return;
+        }
+        OPENPGL_ASSERT(numSamples <= std::numeric_limits<uint32_t>::max());
+        int numEstLeafs = dataStorage.size() + (numSamples * 2) / buildSettings.maxSamples + 32;
+        kdTree.m_nodes.reserve(4 * numEstLeafs);
+        dataStorage.reserve(2 * numEstLeafs);
+
+        const BBox bounds = kdTree.getBounds();
+        const float maxCellIdx = float((1 << MORTON_BITS_PER_DIM) - 1);
+        Vector3 scale;
+        for (int d = 0; d < 3; d++)
+        {
+            const float extent = bounds.upper[d] - bounds.lower[d];
+            scale[d] = extent > 0.f ? float(1 << MORTON_BITS_PER_DIM) / extent : 0.f;
+        }
+
+        std::vector<MortonCode> codes(numSamples);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, numSamples, PARALLEL_PARTITION_BLOCK_SIZE), [&](const tbb::blocked_range<size_t> &r) {
+            for (size_t i = r.begin(); i < r.end(); i++)
             {
-                statsLeft.addSample(samplePosition);
+                const Vector3 samplePosition(samples[i].position.x, samples[i].position.y, samples[i].position.z);
+                uint32_t cellIdx[3];
+                for (int d = 0; d < 3; d++)
+                {
+                    const float c = std::min(std::max((samplePosition[d] - bounds.lower[d]) * scale[d], 0.f), maxCellIdx);
+                    cellIdx[d] = uint32_t(c);
+                }
+                codes[i].code = (expandMortonBits(cellIdx[0]) << 2) | (expandMortonBits(cellIdx[1]) << 1) | expandMortonBits(cellIdx[2]);
+                codes[i].idx = i;
             }
-            else
+        });
+
+#ifdef USE_EMBREE_PARALLEL
+        std::vector<MortonCode> tmpCodes(numSamples);
+        embree::radix_sort_u32(codes.data(), tmpCodes.data(), numSamples);
+        tmpCodes.clear();
+        tmpCodes.shrink_to_fit();
+#else
+        tbb::parallel_sort(codes.begin(), codes.end(), [](const MortonCode &a, const MortonCode &b) {
+            return a.code < b.code || (a.code == b.code && a.idx < b.idx);
+        });
+#endif
+
+        // reorder the samples along the Morton curve
+        {
+            std::vector<typename TSamplesContainer::value_type> sortedSamples(numSamples);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, numSamples, PARALLEL_PARTITION_BLOCK_SIZE), [&](const tbb::blocked_range<size_t> &r) {
+                for (size_t i = r.begin(); i < r.end(); i++)
+                {
+                    sortedSamples[i] = samples[codes[i].idx];
+                }
+            });
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, numSamples, PARALLEL_PARTITION_BLOCK_SIZE), [&](const tbb::blocked_range<size_t> &r) {
+                std::copy(sortedSamples.data() + r.begin(), sortedSamples.data() + r.end(), samples.data() + r.begin());
+            });
+        }
+
+        buildMortonTreeNode(&kdTree, kdTree.getRoot(), 1, bounds, bounds, 3 * MORTON_BITS_PER_DIM - 1, samples, codes.data(), Range(0, numSamples), &dataStorage,
+                            buildSettings);
+    }
+
+    // the samples in sampleRange are sorted by their Morton codes and share all code bits above the given bit,
+    // the node is split at the center of the Morton cell cellBounds along the dimension of the first lower bit
+    // which separates the samples (i.e., levels of the Morton grid with all samples on one side are skipped)
+    // leaves are passed on to updateTreeNode, which splits them further if they still contain too many samples
+    // note: samples within floating point precision of a split plane can end up in the region next to it,
+    // which only affects their first fit since all further updates partition the samples by their positions
+    void buildMortonTreeNode(KDTree *kdTree, KDNode &node, size_t depth, const BBox bounds, BBox cellBounds, int bit, TSamplesContainer &samples, const MortonCode *codes,
+                             const Range sampleRange, tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage, const Settings &buildSettings) const
+    {
+        OPENPGL_ASSERT(node.isLeaf());
+        uint32_t dataIdx = node.getDataIdx();
+        std::pair<TRegion, Range> &regionAndRangeData = dataStorage->operator[](dataIdx);
+        if (depth < buildSettings.maxDepth && regionAndRangeData.first.sampleStatistics.numSamples + sampleRange.size() > buildSettings.maxSamples)
+        {
+            for (; bit >= 0; bit--)
             {
-                statsRight.addSample(samplePosition);
+                const uint32_t bitMask = uint32_t(1) << bit;
+                const uint8_t splitDim = 2 - bit % 3;
+                const float splitPos = 0.5f * (cellBounds.lower[splitDim] + cellBounds.upper[splitDim]);
+                const size_t center = std::partition_point(codes + sampleRange.m_begin, codes + sampleRange.m_end, [bitMask](const MortonCode &c) {
+                                          return (c.code & bitMask) == 0;
+                                      }) -
+                                      codes;
+                if (center == sampleRange.m_begin)
+                {
+                    cellBounds.lower[splitDim] = splitPos;
+                    continue;
+                }
+                if (center == sampleRange.m_end)
+                {
+                    cellBounds.upper[splitDim] = splitPos;
+                    continue;
+                }
+
+                auto regionAndRangeDataRight = regionAndRangeData;
+
+                regionAndRangeData.first.sampleStatistics.split(splitDim, splitPos, 0.25f, false);
+                regionAndRangeDataRight.first.sampleStatistics.split(splitDim, splitPos, 0.25f, true);
+
+                regionAndRangeData.first.splitFlag = true;
+                regionAndRangeDataRight.first.splitFlag = true;
+
+                regionAndRangeData.first.regionBounds.upper[splitDim] = splitPos;
+                regionAndRangeDataRight.first.regionBounds.lower[splitDim] = splitPos;
+
+                auto rightDataItr = dataStorage->push_back(regionAndRangeDataRight);
+                uint32_t rightDataIdx = std::distance(dataStorage->begin(), rightDataItr);
+
+                uint32_t nodeIdsLeftRight[2];
+                nodeIdsLeftRight[0] = kdTree->addChildrenPair();
+                nodeIdsLeftRight[1] = nodeIdsLeftRight[0] + 1;
+                node.setToInnerNode(splitDim, splitPos, nodeIdsLeftRight[0]);
+                kdTree->getNode(nodeIdsLeftRight[0]).setDataNodeIdx(dataIdx);
+                kdTree->getNode(nodeIdsLeftRight[1]).setDataNodeIdx(rightDataIdx);
+
+                BBox bondsLeftRight[2];
+                bondsLeftRight[0] = bondsLeftRight[1] = bounds;
+                bondsLeftRight[0].upper[splitDim] = splitPos;
+                bondsLeftRight[1].lower[splitDim] = splitPos;
+
+                BBox cellBoundsLeftRight[2];
+                cellBoundsLeftRight[0] = cellBoundsLeftRight[1] = cellBounds;
+                cellBoundsLeftRight[0].upper[splitDim] = splitPos;
+                cellBoundsLeftRight[1].lower[splitDim] = splitPos;
+
+                const Range sampleRangeLeft(sampleRange.m_begin, center);
+                const Range sampleRangeRight(center, sampleRange.m_end);
+                tbb::parallel_invoke(
+                    [&] {
+                        buildMortonTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[0]), depth + 1, bondsLeftRight[0], cellBoundsLeftRight[0], bit - 1, samples, codes,
+                                            sampleRangeLeft, dataStorage, buildSettings);
+                    },
+                    [&] {
+                        buildMortonTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[1]), depth + 1, bondsLeftRight[1], cellBoundsLeftRight[1], bit - 1, samples, codes,
+                                            sampleRangeRight, dataStorage, buildSettings);
+                    });
+                return;
             }
-            return left;
-        };
-        return std::partition(begin, end, pivotSplitPredicate);
+        }
+
+        SampleStatistics sampleStats;
+#ifdef USE_INTEGER_ARITHMETIC_STATS
+        IntegerSampleStatistics iSampleStats(bounds);
+        for (size_t i = sampleRange.m_begin; i < sampleRange.m_end; i++)
+        {
+            const Point3 samplePosition(samples[i].position.x, samples[i].position.y, samples[i].position.z);
+            iSampleStats.addSample(samplePosition);
+        }
+        sampleStats = iSampleStats.getSampleStatistics();
+#else
+        sampleStats.clear();
+        for (size_t i = sampleRange.m_begin; i < sampleRange.m_end; i++)
+        {
+            const Point3 samplePosition(samples[i].position.x, samples[i].position.y, samples[i].position.z);
+            sampleStats.addSample(samplePosition);
+        }
+#endif
+        updateTreeNode(kdTree, node, depth, bounds, samples, sampleRange, sampleStats, dataStorage, nullptr, buildSettings);
+    }
+
+    // turns an inner node with two leaf children back into a leaf, the region of the child which received
+    // more samples is kept and extended to the bounds of the node, the distribution and the statistics of
+    // the other region are merged into it and the other region is not referenced anymore
+    template <typename TMergeRegions>
+    void collapseTreeNode(KDTree &kdTree, KDNode &node, tbb::concurrent_vector<std::pair<TRegion, Range> > &dataStorage, TMergeRegions &mergeRegions) const
+    {
+        const uint32_t leftIdx = node.getLeftChildIdx();
+        const uint32_t leftDataIdx = kdTree.getNode(leftIdx).getDataIdx();
+        const uint32_t rightDataIdx = kdTree.getNode(leftIdx + 1).getDataIdx();
+        TRegion &leftRegion = dataStorage[leftDataIdx].first;
+        TRegion &rightRegion = dataStorage[rightDataIdx].first;
+
+        const bool keepLeft = leftRegion.sampleStatistics.numSamples >= rightRegion.sampleStatistics.numSamples;
+        TRegion &region = keepLeft ? leftRegion : rightRegion;
+        TRegion &otherRegion = keepLeft ? rightRegion : leftRegion;
+
+        region.regionBounds = embree::merge(leftRegion.regionBounds, rightRegion.regionBounds);
+        if (otherRegion.sampleStatistics.numSamples > 0.f)
+        {
+            mergeRegions(region, otherRegion);
+            region.sampleStatistics.merge(otherRegion.sampleStatistics);
+        }
+        region.numZeroValueSamples += otherRegion.numZeroValueSamples;
+        node.setDataNodeIdx(keepLeft ? leftDataIdx : rightDataIdx);
     }
 
-#ifdef USE_EMBREE_PARALLEL
     template <class DataType>
     inline size_t pivotSplitSamples2(DataType *samples, const size_t begin, const size_t end, uint8_t splitDimension, float pivot) const
     {
@@ -179,11 +506,19 @@ struct KDTreePartitionBuilder
         bool parallel = (end - begin) < PARALLEL_THRESHOLD ? false : true;
         if (!parallel)
         {
+#ifdef USE_EMBREE_PARALLEL
             center = embree::serial_partitioning(samples, begin, end, isLeft);
+#else
+            center = serialPartition(samples, begin, end, isLeft);
+#endif
         }
         else
         {
+#ifdef USE_EMBREE_PARALLEL
             center = embree::parallel_partitioning(samples, begin, end, isLeft, PARALLEL_PARTITION_BLOCK_SIZE);
+#else
+            center = parallelPartition(samples, begin, end, isLeft, PARALLEL_PARTITION_BLOCK_SIZE);
+#endif
         }
         return center;
     }
@@ -195,25 +530,29 @@ struct KDTreePartitionBuilder
             const Vector3 v(sample.position.x, sample.position.y, sample.position.z);
             return v[splitDimension] < pivot;
         };
+        auto addSample = [](SampleStatistics &sstats, const PGLSampleData &sample) {
+            sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
+        };
+        auto mergeStats = [](SampleStatistics &sstats0, const SampleStatistics &sstats1) {
+            sstats0.merge(sstats1);
+        };
         size_t center = 0;
         bool parallel = (end - begin) < PARALLEL_THRESHOLD ? false : true;
         if (!parallel)
         {
-            center = embree::serial_partitioning(samples, begin, end, statsLeft, statsRight, isLeft, [](SampleStatistics &sstats, const PGLSampleData &sample) {
-                sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
-            });
+#ifdef USE_EMBREE_PARALLEL
+            center = embree::serial_partitioning(samples, begin, end, statsLeft, statsRight, isLeft, addSample);
+#else
+            center = serialPartition(samples, begin, end, statsLeft, statsRight, isLeft, addSample);
+#endif
         }
         else
         {
-            center = embree::parallel_partitioning(
-                samples, begin, end, SampleStatistics(), statsLeft, statsRight, isLeft,
-                [](SampleStatistics &sstats, const PGLSampleData &sample) {
-                    sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
-                },
-                [](SampleStatistics &sstats0, const SampleStatistics &sstats1) {
-                    sstats0.merge(sstats1);
-                },
-                PARALLEL_PARTITION_BLOCK_SIZE);
+#ifdef USE_EMBREE_PARALLEL
+            center = embree::parallel_partitioning(samples, begin, end, SampleStatistics(), statsLeft, statsRight, isLeft, addSample, mergeStats, PARALLEL_PARTITION_BLOCK_SIZE);
+#else
+            center = parallelPartition(samples, begin, end, SampleStatistics(), statsLeft, statsRight, isLeft, addSample, mergeStats, PARALLEL_PARTITION_BLOCK_SIZE);
+#endif
         }
         return center;
     }
@@ -225,37 +564,38 @@ struct KDTreePartitionBuilder
             const Vector3 v(sample.position.x, sample.position.y, sample.position.z);
             return v[splitDimension] < pivot;
         };
+        auto addSample = [](IntegerSampleStatistics &sstats, const PGLSampleData &sample) {
+            sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
+        };
+        auto mergeStats = [](IntegerSampleStatistics &sstats0, const IntegerSampleStatistics &sstats1) {
+            sstats0.merge(sstats1);
+        };
         size_t center = 0;
         bool runParallel = (end - begin) < PARALLEL_THRESHOLD || parallel == false ? false : true;
+        IntegerSampleStatistics iStatsLeft(bounds);
+        IntegerSampleStatistics iStatsRight(bounds);
         if (!runParallel)
         {
-            IntegerSampleStatistics iStatsLeft(bounds);
-            IntegerSampleStatistics iStatsRight(bounds);
-            center = embree::serial_partitioning(samples, begin, end, iStatsLeft, iStatsRight, isLeft, [](IntegerSampleStatistics &sstats, const PGLSampleData &sample) {
-                sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
-            });
-            statsLeft = iStatsLeft.getSampleStatistics();
-            statsRight = iStatsRight.getSampleStatistics();
+#ifdef USE_EMBREE_PARALLEL
+            center = embree::serial_partitioning(samples, begin, end, iStatsLeft, iStatsRight, isLeft, addSample);
+#else
+            center = serialPartition(samples, begin, end, iStatsLeft, iStatsRight, isLeft, addSample);
+#endif
         }
         else
         {
-            IntegerSampleStatistics iStatsLeft(bounds);
-            IntegerSampleStatistics iStatsRight(bounds);
-            center = embree::parallel_partitioning(
-                samples, begin, end, IntegerSampleStatistics(bounds), iStatsLeft, iStatsRight, isLeft,
-                [](IntegerSampleStatistics &sstats, const PGLSampleData &sample) {
-                    sstats.addSample(Vector3(sample.position.x, sample.position.y, sample.position.z));
-                },
-                [](IntegerSampleStatistics &sstats0, const IntegerSampleStatistics &sstats1) {
-                    sstats0.merge(sstats1);
-                },
-                PARALLEL_PARTITION_BLOCK_SIZE);
-            statsLeft = iStatsLeft.getSampleStatistics();
-            statsRight = iStatsRight.getSampleStatistics();
+#ifdef USE_EMBREE_PARALLEL
+            center = embree::parallel_partitioning(samples, begin, end, IntegerSampleStatistics(bounds), iStatsLeft, iStatsRight, isLeft, addSample, mergeStats,
+                                                   PARALLEL_PARTITION_BLOCK_SIZE);
+#else
+            center = parallelPartition(samples, begin, end, IntegerSampleStatistics(bounds), iStatsLeft, iStatsRight, isLeft, addSample, mergeStats,
+                                       PARALLEL_PARTITION_BLOCK_SIZE);
+#endif
         }
+        statsLeft = iStatsLeft.getSampleStatistics();
+        statsRight = iStatsRight.getSampleStatistics();
         return center;
     }
-#endif
 
     inline void getSplitDimensionAndPosition(const SampleStatistics &sampleStats, uint8_t &splitDim, float &splitPos) const
     {
@@ -270,11 +610,172 @@ struct KDTreePartitionBuilder
         splitPos = sampleMean[splitDim];
     }
 
+    // number of samples and sum of their directions per bin and axis for the binned split heuristic,
+    // the sums are accumulated in fixed point so that the result of the parallel reduction does not
+    // depend on the order the bins are merged in (i.e., on the number of threads)
+    struct SplitBins
+    {
+        static const size_t MAX_NUM_BINS = 32;
+        static constexpr float DIRECTION_SCALE = float(1 << 20);
+
+        uint32_t numSamples[3][MAX_NUM_BINS];
+        int64_t directionSums[3][MAX_NUM_BINS][3];
+
+        SplitBins()
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                for (size_t b = 0; b < MAX_NUM_BINS; b++)
+                {
+                    numSamples[d][b] = 0;
+                    directionSums[d][b][0] = directionSums[d][b][1] = directionSums[d][b][2] = 0;
+                }
+            }
+        }
+
+        void addSample(const int d, const size_t b, const Vector3 &direction)
+        {
+            numSamples[d][b]++;
+            directionSums[d][b][0] += int64_t(direction.x * DIRECTION_SCALE);
+            directionSums[d][b][1] += int64_t(direction.y * DIRECTION_SCALE);
+            directionSums[d][b][2] += int64_t(direction.z * DIRECTION_SCALE);
+        }
+
+        Vector3 getDirectionSum(const int d, const size_t b) const
+        {
+            return Vector3(float(directionSums[d][b][0]), float(directionSums[d][b][1]), float(directionSums[d][b][2])) * (1.f / DIRECTION_SCALE);
+        }
+
+        static SplitBins merge(const SplitBins &a, const SplitBins &b)
+        {
+            SplitBins bins;
+            for (int d = 0; d < 3; d++)
+            {
+                for (size_t i = 0; i < MAX_NUM_BINS; i++)
+                {
+                    bins.numSamples[d][i] = a.numSamples[d][i] + b.numSamples[d][i];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        bins.directionSums[d][i][k] = a.directionSums[d][i][k] + b.directionSums[d][i][k];
+                    }
+                }
+            }
+            return bins;
+        }
+    };
+
+    // evaluates numBins - 1 equidistant candidate planes per axis inside the sample bounds and selects the one
+    // which minimizes the directional spread of the two children plus a small penalty for unbalanced sample
+    // counts, the spread of N samples is N - |sum of their directions| (i.e., zero if all directions are equal)
+    // the candidates are evaluated on the new samples of the leaf, if the best candidate does not reduce the
+    // spread by more than the noise level of isotropic directions (~sqrt(N)) the mean split is used instead
+    inline void getBinnedSplitDimensionAndPosition(const SampleStatistics &sampleStats, const BBox &bounds, TSamplesContainer &samples, const Range &sampleRange,
+                                                   const size_t numSplitBins, uint8_t &splitDim, float &splitPos) const
+    {
+        const size_t numBins = std::min(numSplitBins, SplitBins::MAX_NUM_BINS);
+        const BBox binBounds = embree::intersect(sampleStats.sampleBounds, bounds);
+        const Vector3 binExtent = binBounds.size();
+        Vector3 binScale;
+        for (int d = 0; d < 3; d++)
+        {
+            binScale[d] = binExtent[d] > 0.f ? float(numBins) / binExtent[d] : 0.f;
+        }
+
+        auto binSamples = [&](const size_t begin, const size_t end, SplitBins &bins) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const typename TSamplesContainer::value_type &sample = samples[i];
+                const Vector3 position(sample.position.x, sample.position.y, sample.position.z);
+                const pgl_vec3f dir = sample.direction;
+                const Vector3 direction(dir.x, dir.y, dir.z);
+                for (int d = 0; d < 3; d++)
+                {
+                    const size_t bin = std::min(numBins - 1, size_t(std::max(0.f, (position[d] - binBounds.lower[d]) * binScale[d])));
+                    bins.addSample(d, bin, direction);
+                }
+            }
+        };
+#ifdef USE_EMBREE_PARALLEL
+        const SplitBins bins = embree::parallel_reduce(
+            sampleRange.m_begin, sampleRange.m_end, size_t(4 * 1024), SplitBins(),
+            [&](const embree::range<size_t> &r) -> SplitBins {
+                SplitBins bins;
+                binSamples(r.begin(), r.end(), bins);
+                return bins;
+            },
+            [](const SplitBins &a, const SplitBins &b) {
+                return SplitBins::merge(a, b);
+            });
+#else
+        const SplitBins bins = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(sampleRange.m_begin, sampleRange.m_end, 4 * 1024), SplitBins(),
+            [&](const tbb::blocked_range<size_t> &r, SplitBins bins) -> SplitBins {
+                binSamples(r.begin(), r.end(), bins);
+                return bins;
+            },
+            [](const SplitBins &a, const SplitBins &b) {
+                return SplitBins::merge(a, b);
+            });
+#endif
+
+        const float balanceWeight = 0.05f;
+        const float numSamples = float(sampleRange.size());
+        float bestCost = std::numeric_limits<float>::infinity();
+        float bestSpread = 0.f;
+        Vector3 directionSum(0.f);
+        for (size_t b = 0; b < numBins; b++)
+        {
+            directionSum += bins.getDirectionSum(0, b);
+        }
+        const float spread = numSamples - embree::length(directionSum);
+
+        for (int d = 0; d < 3; d++)
+        {
+            if (binScale[d] <= 0.f)
+            {
+                continue;
+            }
+            float numSamplesLeft = 0.f;
+            Vector3 directionSumLeft(0.f);
+            for (size_t b = 1; b < numBins; b++)
+            {
+                numSamplesLeft += float(bins.numSamples[d][b - 1]);
+                directionSumLeft += bins.getDirectionSum(d, b - 1);
+                const float numSamplesRight = numSamples - numSamplesLeft;
+                if (numSamplesLeft == 0.f || numSamplesRight == 0.f)
+                {
+                    continue;
+                }
+                const float spreadLeftRight = numSamplesLeft - embree::length(directionSumLeft) + numSamplesRight - embree::length(directionSum - directionSumLeft);
+                const float cost = spreadLeftRight + balanceWeight * std::fabs(numSamplesLeft - numSamplesRight);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestSpread = spreadLeftRight;
+                    splitDim = d;
+                    splitPos = binBounds.lower[d] + float(b) * (binExtent[d] / float(numBins));
+                }
+            }
+        }
+
+        if (!(bestCost < std::numeric_limits<float>::infinity()) || spread - bestSpread <= 2.f * std::sqrt(numSamples))
+        {
+            getSplitDimensionAndPosition(sampleStats, splitDim, splitPos);
+        }
+    }
+
     void updateTreeNode(KDTree *kdTree, KDNode &node, size_t depth, const BBox bounds, TSamplesContainer &samples, const Range sampleRange, const SampleStatistics &sampleStats,
-                        tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage, const Settings &buildSettings, bool parallel = true) const
+                        tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage, tbb::concurrent_vector<uint32_t> *touchedDataIdxs, const Settings &buildSettings,
+                        bool parallel = true) const
     {
         if (sampleRange.size() <= 0)
         {
+            // a region which was just created by a split but did not receive any samples
+            // still needs to be visited to apply the decay of its statistics
+            if (touchedDataIdxs && node.isLeaf() && dataStorage->operator[](node.getDataIdx()).first.splitFlag)
+            {
+                touchedDataIdxs->push_back(node.getDataIdx());
+            }
             return;
         }
         uint8_t splitDim = {0};
@@ -294,7 +795,14 @@ struct KDTreePartitionBuilder
             {
                 SampleStatistics mergedSampleStats = regionAndRangeData.first.sampleStatistics;
                 mergedSampleStats.merge(sampleStats);
-                getSplitDimensionAndPosition(mergedSampleStats, splitDim, splitPos);
+                if (buildSettings.numSplitBins > 1)
+                {
+                    getBinnedSplitDimensionAndPosition(mergedSampleStats, bounds, samples, sampleRange, buildSettings.numSplitBins, splitDim, splitPos);
+                }
+                else
+                {
+                    getSplitDimensionAndPosition(mergedSampleStats, splitDim, splitPos);
+                }
 
                 // regionAndRangeData.first.onSplit();
                 auto regionAndRangeDataRight = regionAndRangeData;
@@ -327,6 +835,10 @@ struct KDTreePartitionBuilder
             {
                 regionAndRangeData.first.sampleStatistics.merge(sampleStats);
                 regionAndRangeData.second = sampleRange;
+                if (touchedDataIdxs)
+                {
+                    touchedDataIdxs->push_back(dataIdx);
+                }
                 return;
             }
         }
@@ -348,55 +860,73 @@ struct KDTreePartitionBuilder
         bondsLeftRight[0].upper[splitDim] = splitPos;
         bondsLeftRight[1].lower[splitDim] = splitPos;
 
-#ifdef USE_EMBREE_PARALLEL
         size_t rPivotItr = 0;
-#else
-        typename TSamplesContainer::iterator rPivotItr(nullptr);
-        auto begin = samples.begin() + sampleRange.m_begin, end = samples.begin() + sampleRange.m_end;
-#endif
         if (kdTree->getNode(nodeIdsLeftRight[0]).isLeaf() || kdTree->getNode(nodeIdsLeftRight[1]).isLeaf())
         {
             // splitStats = true;
-#ifdef USE_EMBREE_PARALLEL
 #ifndef USE_INTEGER_ARITHMETIC_STATS
             rPivotItr = pivotSplitSamplesWithStats2(samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos, sampleStatsLeftRight[0], sampleStatsLeftRight[1]);
 #else
             rPivotItr = pivotSplitSamplesWithStats3(bounds, samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos, sampleStatsLeftRight[0],
                                                     sampleStatsLeftRight[1], parallel);
-#endif
-#else
-            rPivotItr = pivotSplitSamplesWithStats(begin, end, splitDim, splitPos, sampleStatsLeftRight[0], sampleStatsLeftRight[1]);
 #endif
         }
         else
         {
-#ifdef USE_EMBREE_PARALLEL
             rPivotItr = pivotSplitSamples2<typename TSamplesContainer::value_type>(samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos);
-#else
-            rPivotItr = pivotSplitSamples<TSamplesContainer>(begin, end, splitDim, splitPos);
-#endif
         }
 
-#ifdef USE_EMBREE_PARALLEL
         sampleRangeLeftRight[0] = Range(sampleRange.m_begin, rPivotItr);
         sampleRangeLeftRight[1] = Range(rPivotItr, sampleRange.m_end);
-#else
-        sampleRangeLeftRight[0] = Range(sampleRange.m_begin, std::distance(samples.begin(), rPivotItr));
-        sampleRangeLeftRight[1] = Range(std::distance(samples.begin(), rPivotItr), sampleRange.m_end);
-#endif
         tbb::parallel_invoke(
             [&] {
                 updateTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[0]), depth + 1, bondsLeftRight[0], samples, sampleRangeLeftRight[0], sampleStatsLeftRight[0], dataStorage,
-                               buildSettings, true);
+                               touchedDataIdxs, buildSettings, true);
             },
             [&] {
                 updateTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[1]), depth + 1, bondsLeftRight[1], samples, sampleRangeLeftRight[1], sampleStatsLeftRight[1], dataStorage,
-                               buildSettings, true);
+                               touchedDataIdxs, buildSettings, true);
+            });
+    }
+
+    void partitionTreeNode(KDTree *kdTree, KDNode &node, TSamplesContainer &samples, const Range sampleRange, tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage,
+                           tbb::concurrent_vector<uint32_t> *touchedDataIdxs) const
+    {
+        if (sampleRange.size() == 0)
+        {
+            return;
+        }
+
+        if (node.isLeaf())
+        {
+            uint32_t dataIdx = node.getDataIdx();
+            dataStorage->operator[](dataIdx).second = sampleRange;
+            if (touchedDataIdxs)
+            {
+                touchedDataIdxs->push_back(dataIdx);
+            }
+            return;
+        }
+
+        const uint8_t splitDim = node.getSplitDim();
+        const float splitPos = node.getSplitPivot();
+        const uint32_t leftChildIdx = node.getLeftChildIdx();
+
+        size_t rPivotItr = pivotSplitSamples2<typename TSamplesContainer::value_type>(samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos);
+
+        const Range sampleRangeLeft(sampleRange.m_begin, rPivotItr);
+        const Range sampleRangeRight(rPivotItr, sampleRange.m_end);
+        tbb::parallel_invoke(
+            [&] {
+                partitionTreeNode(kdTree, kdTree->getNode(leftChildIdx), samples, sampleRangeLeft, dataStorage, touchedDataIdxs);
+            },
+            [&] {
+                partitionTreeNode(kdTree, kdTree->getNode(leftChildIdx + 1), samples, sampleRangeRight, dataStorage, touchedDataIdxs);
             });
     }
 
     void insertTreeNode(KDTree *kdTree, KDNode &node, size_t depth, TZeroValueSamplesContainer &samples, const Range sampleRange,
-                        tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage) const
+                        tbb::concurrent_vector<std::pair<TRegion, Range> > *dataStorage, tbb::concurrent_vector<uint32_t> *touchedDataIdxs) const
     {
         if (sampleRange.size() == 0)
         {
@@ -418,6 +948,10 @@ struct KDTreePartitionBuilder
             regionAndRangeData.second.m_is_begin = sampleRange.m_begin;
             regionAndRangeData.second.m_is_end = sampleRange.m_end;
 #endif
+            if (touchedDataIdxs)
+            {
+                touchedDataIdxs->push_back(dataIdx);
+            }
             return;
         }
         else
@@ -431,25 +965,10 @@ struct KDTreePartitionBuilder
         OPENPGL_ASSERT(!node.isLeaf());
         OPENPGL_ASSERT(sampleRange.size() > 0);
 
-#ifdef USE_EMBREE_PARALLEL
-        size_t rPivotItr = 0;
-#else
-        typename TZeroValueSamplesContainer::iterator rPivotItr;
-        auto begin = samples.begin() + sampleRange.m_begin, end = samples.begin() + sampleRange.m_end;
-#endif
-#ifdef USE_EMBREE_PARALLEL
-        rPivotItr = pivotSplitSamples2<typename TZeroValueSamplesContainer::value_type>(samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos);
-#else
-        rPivotItr = pivotSplitSamples<TZeroValueSamplesContainer>(begin, end, splitDim, splitPos);
-#endif
+        size_t rPivotItr = pivotSplitSamples2<typename TZeroValueSamplesContainer::value_type>(samples.data(), sampleRange.m_begin, sampleRange.m_end, splitDim, splitPos);
 
-#ifdef USE_EMBREE_PARALLEL
         sampleRangeLeftRight[0] = Range(sampleRange.m_begin, rPivotItr);
         sampleRangeLeftRight[1] = Range(rPivotItr, sampleRange.m_end);
-#else
-        sampleRangeLeftRight[0] = Range(sampleRange.m_begin, std::distance(samples.begin(), rPivotItr));
-        sampleRangeLeftRight[1] = Range(std::distance(samples.begin(), rPivotItr), sampleRange.m_end);
-#endif
         /* This assert is a sanity check which is only valid with the assumption that the number of samples grows at same pace
            as the number of spatial nodes: in practice this is not the case (e.g., after many 1spp iterations)
         */
@@ -458,10 +977,10 @@ struct KDTreePartitionBuilder
 
         tbb::parallel_invoke(
             [&] {
-                insertTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[0]), depth + 1, samples, sampleRangeLeftRight[0], dataStorage);
+                insertTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[0]), depth + 1, samples, sampleRangeLeftRight[0], dataStorage, touchedDataIdxs);
             },
             [&] {
-                insertTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[1]), depth + 1, samples, sampleRangeLeftRight[1], dataStorage);
+                insertTreeNode(kdTree, kdTree->getNode(nodeIdsLeftRight[1]), depth + 1, samples, sampleRangeLeftRight[1], dataStorage, touchedDataIdxs);
             });
     }
 };
@@ -482,6 +1001,8 @@ inline std::string KDTreePartitionBuilder<TRegion, TSamplesContainer, TZeroValue
     ss << "  minSamples: " << minSamples << std::endl;
     ss << "  maxSamples: " << maxSamples << std::endl;
     ss << "  maxDepth: " << maxDepth << std::endl;
+    ss << "  numSplitBins: " << numSplitBins << std::endl;
+    ss << "  mortonBuild: " << mortonBuild << std::endl;
 
     return ss.str();
 }
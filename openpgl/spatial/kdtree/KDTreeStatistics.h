@@ -61,5 +61,19 @@ struct KDTreeStatistics
         ss << tab << "sizeAllNodesReserved     = " << float(sizeAllNodesReserved) / 1024 << " kbs" << std::endl;
         return ss.str();
     }
+
+    std::string toJSONString() const
+    {
+        std::stringstream ss;
+        ss << "{";
+        ss << "\"numberOfNodes\": " << numberOfNodes;
+        ss << ", \"numberOfReservedNodes\": " << numberOfReservedNodes;
+        ss << ", \"maxDepth\": " << maxDepth;
+        ss << ", \"sizePerNode\": " << sizePerNode;
+        ss << ", \"sizeAllNodesUsed\": " << sizeAllNodesUsed;
+        ss << ", \"sizeAllNodesReserved\": " << sizeAllNodesReserved;
+        ss << "}";
+        return ss.str();
+    }
 };
 }  // namespace openpgl
@@ -0,0 +1,165 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "../../openpgl_common.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <vector>
+
+// partitioning algorithms used to build the spatial structures if the embree algorithms are not
+// available (i.e., USE_EMBREE_PARALLEL is not defined), the predicate and the reductions are
+// template parameters to allow inlining them into the partitioning loops
+
+namespace openpgl
+{
+
+// partitions array[begin, end) such that all elements for which isLeft is true are placed before
+// all other elements, reduceElement(leftReduction/rightReduction, element) is called for every element
+// of the left/right side (e.g., to collect the sample statistics of both sides)
+// returns the index of the first element of the right side
+template <typename T, typename V, typename IsLeft, typename ReduceElement>
+inline size_t serialPartition(T *array, const size_t begin, const size_t end, V &leftReduction, V &rightReduction, const IsLeft &isLeft, const ReduceElement &reduceElement)
+{
+    size_t l = begin;
+    size_t r = end;
+    while (true)
+    {
+        while (l < r && isLeft(array[l]))
+        {
+            reduceElement(leftReduction, array[l]);
+            l++;
+        }
+        while (l < r && !isLeft(array[r - 1]))
+        {
+            reduceElement(rightReduction, array[r - 1]);
+            r--;
+        }
+        if (l >= r)
+        {
+            break;
+        }
+        // array[l] belongs to the right and array[r - 1] to the left side
+        reduceElement(leftReduction, array[r - 1]);
+        reduceElement(rightReduction, array[l]);
+        std::swap(array[l], array[r - 1]);
+        l++;
+        r--;
+    }
+    return l;
+}
+
+// parallel version of serialPartition which processes the range in blocks of blockSize elements:
+// each block is partitioned in place in parallel, the prefix sum of the per-block counts gives the
+// position of the global split and the right side elements of the blocks which lie before the split are
+// then swapped in parallel with the left side elements of the blocks which lie after it
+// the per-block reductions are merged into leftReduction/rightReduction using reduceReductions(a, b)
+// in block order, the result therefore only depends on the input and the block size but not on the
+// number of threads
+template <typename T, typename V, typename IsLeft, typename ReduceElement, typename ReduceReductions>
+inline size_t parallelPartition(T *array, const size_t begin, const size_t end, const V &identity, V &leftReduction, V &rightReduction, const IsLeft &isLeft,
+                                const ReduceElement &reduceElement, const ReduceReductions &reduceReductions, const size_t blockSize)
+{
+    const size_t num = end - begin;
+    if (num <= blockSize)
+    {
+        return serialPartition(array, begin, end, leftReduction, rightReduction, isLeft, reduceElement);
+    }
+
+    const size_t numBlocks = (num + blockSize - 1) / blockSize;
+    std::vector<size_t> blockCenters(numBlocks);
+    std::vector<V> blockLeftReductions(numBlocks, identity);
+    std::vector<V> blockRightReductions(numBlocks, identity);
+    tbb::parallel_for(size_t(0), numBlocks, [&](const size_t b) {
+        const size_t blockBegin = begin + b * blockSize;
+        const size_t blockEnd = std::min(end, blockBegin + blockSize);
+        blockCenters[b] = serialPartition(array, blockBegin, blockEnd, blockLeftReductions[b], blockRightReductions[b], isLeft, reduceElement);
+    });
+
+    size_t center = begin;
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        center += blockCenters[b] - (begin + b * blockSize);
+        reduceReductions(leftReduction, blockLeftReductions[b]);
+        reduceReductions(rightReduction, blockRightReductions[b]);
+    }
+
+    // collects the misplaced ranges: right side elements in front of center and
+    // left side elements behind center (both sets contain the same number of elements)
+    std::vector<size_t> misplacedRightBegin, misplacedRightOffset(1, 0);
+    std::vector<size_t> misplacedLeftBegin, misplacedLeftOffset(1, 0);
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        const size_t blockBegin = begin + b * blockSize;
+        const size_t blockEnd = std::min(end, blockBegin + blockSize);
+        const size_t rightBegin = blockCenters[b];
+        const size_t rightEnd = std::min(blockEnd, center);
+        if (rightBegin < rightEnd)
+        {
+            misplacedRightBegin.push_back(rightBegin);
+            misplacedRightOffset.push_back(misplacedRightOffset.back() + rightEnd - rightBegin);
+        }
+        const size_t leftBegin = std::max(blockBegin, center);
+        const size_t leftEnd = blockCenters[b];
+        if (leftBegin < leftEnd)
+        {
+            misplacedLeftBegin.push_back(leftBegin);
+            misplacedLeftOffset.push_back(misplacedLeftOffset.back() + leftEnd - leftBegin);
+        }
+    }
+
+    const size_t numMisplaced = misplacedRightOffset.back();
+    OPENPGL_ASSERT(numMisplaced == misplacedLeftOffset.back());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numMisplaced, blockSize), [&](const tbb::blocked_range<size_t> &r) {
+        size_t i = r.begin();
+        size_t rightIdx = std::upper_bound(misplacedRightOffset.begin(), misplacedRightOffset.end(), i) - misplacedRightOffset.begin() - 1;
+        size_t leftIdx = std::upper_bound(misplacedLeftOffset.begin(), misplacedLeftOffset.end(), i) - misplacedLeftOffset.begin() - 1;
+        while (i < r.end())
+        {
+            // swaps the largest chunk which lies within one right and one left range
+            const size_t chunkEnd = std::min(r.end(), std::min(misplacedRightOffset[rightIdx + 1], misplacedLeftOffset[leftIdx + 1]));
+            T *right = array + misplacedRightBegin[rightIdx] + (i - misplacedRightOffset[rightIdx]);
+            T *left = array + misplacedLeftBegin[leftIdx] + (i - misplacedLeftOffset[leftIdx]);
+            std::swap_ranges(right, right + (chunkEnd - i), left);
+            i = chunkEnd;
+            if (i == misplacedRightOffset[rightIdx + 1])
+            {
+                rightIdx++;
+            }
+            if (i == misplacedLeftOffset[leftIdx + 1])
+            {
+                leftIdx++;
+            }
+        }
+    });
+    return center;
+}
+
+// parallelPartition without reductions
+template <typename T, typename IsLeft>
+inline size_t parallelPartition(T *array, const size_t begin, const size_t end, const IsLeft &isLeft, const size_t blockSize)
+{
+    struct NoReduction
+    {
+    };
+    NoReduction leftReduction, rightReduction;
+    return parallelPartition(
+        array, begin, end, NoReduction(), leftReduction, rightReduction, isLeft, [](NoReduction &, const T &) {}, [](NoReduction &, const NoReduction &) {}, blockSize);
+}
+
+// serialPartition without reductions
+template <typename T, typename IsLeft>
+inline size_t serialPartition(T *array, const size_t begin, const size_t end, const IsLeft &isLeft)
+{
+    struct NoReduction
+    {
+    };
+    NoReduction leftReduction, rightReduction;
+    return serialPartition(array, begin, end, leftReduction, rightReduction, isLeft, [](NoReduction &, const T &) {});
+}
+
+}  // namespace openpgl
@@ -18,7 +18,7 @@ namespace embree
     
     assert((align & (align-1)) == 0);
     void* ptr = nullptr;
-    posix_memalign(&ptr, size, align);
+    posix_memalign(&ptr, align, size);
 
     if (size != 0 && ptr == nullptr)
       throw std::bad_alloc();